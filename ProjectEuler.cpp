@@ -2,19 +2,42 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <atomic>
+#include <climits>
 #include <deque>
 #include <functional>
 #include <map>
 #include <math.h>
+#include <mutex>
 #include <numeric>
 #include <set>
+#include <shared_mutex>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <string>
+#include <thread>
+#include <type_traits>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 
 ////////////////////////////
 ////////////////////////////
@@ -29,6 +52,48 @@ typedef std::set<BigInt> BigIntSet;
 
 typedef std::vector<std::string> StringList;
 
+////////////////////////////
+// Bits
+
+inline BigInt CalcPopCount(uint64_t bits)
+{
+#ifdef _MSC_VER
+    return (BigInt)__popcnt64(bits);
+#else
+    return (BigInt)__builtin_popcountll(bits);
+#endif
+}
+
+inline BigInt CalcLowestSetBit(uint64_t bits)
+{
+    assert(bits != 0);
+#ifdef _MSC_VER
+    unsigned long index = 0;
+    _BitScanForward64(&index, bits);
+    return (BigInt)index;
+#else
+    return (BigInt)__builtin_ctzll(bits);
+#endif
+}
+
+////////////////////////////
+// Roots
+
+BigInt CalcSqrtFloor(BigInt num)
+{
+    // the double sqrt can be off by one above 2^53, so nudge the result to the exact floor
+    BigInt root = (BigInt)sqrt((double)num);
+    while ((root > 0) && (root * root > num))
+    {
+        --root;
+    }
+    while ((root < 3037000499LL) && ((root + 1) * (root + 1) <= num))
+    {
+        ++root;
+    }
+    return root;
+}
+
 ////////////////////////////
 // Strings
 
@@ -67,442 +132,3492 @@ void ReadStringList(const char* fileName, StringList& list)
 }
 
 ////////////////////////////
-// Factorization
+// Files
 
-class Factorization : public std::map<BigInt, BigInt>
+// A whole file mapped read-only into memory, so every process mapping the same file shares its pages
+class MappedFile
 {
 public:
-    Factorization() : std::map<BigInt, BigInt>() {}
+    MappedFile() : m_data(nullptr), m_size(0)
+#ifdef _WIN32
+        , m_mapping(NULL)
+#endif
+    {
+    }
+    ~MappedFile() { Close(); }
 
-    bool IsPrime() const { return ((size() == 1) && (begin()->second == 1)); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
 
-    void Absorb(const Factorization& other)
+    bool Open(const char* fileName)
     {
-        for (auto iter = other.begin(); iter != other.end(); ++iter)
+        Close();
+
+#ifdef _WIN32
+        HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
         {
-            Absorb(iter->first, iter->second);
+            return false;
         }
-    }
 
-    BigInt CalcProduct() const
-    {
-        BigInt product = 1;
-        for (auto iter = begin(); iter != end(); ++iter)
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || (fileSize.QuadPart <= 0))
         {
-            for (BigInt i = 0; i < iter->second; ++i)
-            {
-                product *= iter->first;
-            }
+            CloseHandle(file);
+            return false;
         }
-        return product;
-    }
 
-    void PrintFactors() const
-    {
-        for (auto iter = begin(); iter != end(); ++iter)
+        m_mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        CloseHandle(file);
+        if (m_mapping == NULL)
         {
-            printf("(%lldn of %lld) ", iter->second, iter->first);
+            return false;
         }
-    }
 
-    BigInt CalcNumDivisors() const
-    {
-        if (IsPrime())
+        m_data = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+        if (m_data == nullptr)
         {
-            // if prime, then number of divisors is simply:  1, and itself
-            return 2;
+            CloseHandle(m_mapping);
+            m_mapping = NULL;
+            return false;
+        }
+        m_size = (BigInt)fileSize.QuadPart;
+#else
+        const int file = open(fileName, O_RDONLY);
+        if (file < 0)
+        {
+            return false;
         }
 
-        BigInt numDivisors = 1;
-        // the number of divisors will be the numbers of combinations of prime factors.
-        // in a given divisor, each prime factor can be included from 0 to N times, where
-        // N is the number of times that prime factor exists in the original number.
-        // (the divisor with ZERO of any prime factors included, is the divisor 1, which every number has.)
-        for (auto iter = begin(); iter != end(); ++iter)
+        struct stat fileStat;
+        if ((fstat(file, &fileStat) != 0) || (fileStat.st_size <= 0))
         {
-            numDivisors *= (iter->second + 1);
+            close(file);
+            return false;
         }
-        // add 1 more for the original number, being one of its own divisors
-        numDivisors += 1;
 
-        return numDivisors;
+        void* data = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_SHARED, file, 0);
+        close(file);
+        if (data == MAP_FAILED)
+        {
+            return false;
+        }
+
+        m_data = data;
+        m_size = (BigInt)fileStat.st_size;
+#endif
+
+        return true;
     }
 
-private:
-    void Absorb(BigInt number, BigInt numFactors)
+    void Close()
     {
-        auto iter = find(number);
-        if (iter != end())
+        if (m_data == nullptr)
         {
-            iter->second = std::max(iter->second, numFactors);
-        }
-        else
-        {
-            insert(value_type(number, numFactors));
+            return;
         }
+
+#ifdef _WIN32
+        UnmapViewOfFile(m_data);
+        CloseHandle(m_mapping);
+        m_mapping = NULL;
+#else
+        munmap(m_data, (size_t)m_size);
+#endif
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+    void Swap(MappedFile& other)
+    {
+        std::swap(m_data, other.m_data);
+        std::swap(m_size, other.m_size);
+#ifdef _WIN32
+        std::swap(m_mapping, other.m_mapping);
+#endif
     }
+
+    bool IsOpen() const { return (m_data != nullptr); }
+    const void* GetData() const { return m_data; }
+    BigInt GetSize() const { return m_size; }
+
+
+private:
+    void* m_data;
+    BigInt m_size;
+#ifdef _WIN32
+    HANDLE m_mapping;
+#endif
 };
 
-class FactorizationCache : public std::map<BigInt, Factorization>
+////////////////////////////
+// Modular arithmetic
+
+inline uint64_t CalcMulHigh64(uint64_t a, uint64_t b)
 {
-public:
-    FactorizationCache() : std::map<BigInt, Factorization>() {}
+#ifdef _MSC_VER
+    return __umulh(a, b);
+#else
+    return (uint64_t)(((unsigned __int128)a * b) >> 64);
+#endif
+}
+
+// (high * 2^64 + low) / divisor, for high < divisor (so the quotient fits in 64 bits)
+inline uint64_t CalcDiv128(uint64_t high, uint64_t low, uint64_t divisor, uint64_t* remainder)
+{
+    assert(high < divisor);
+#ifdef _MSC_VER
+    return _udiv128(high, low, divisor, remainder);
+#else
+    const unsigned __int128 numer = ((unsigned __int128)high << 64) | low;
+    *remainder = (uint64_t)(numer % divisor);
+    return (uint64_t)(numer / divisor);
+#endif
+}
 
-    void PopulateCache(BigInt num) { Factorize(num * 2); }
+inline uint64_t CalcMulMod64(uint64_t a, uint64_t b, uint64_t mod)
+{
+#ifdef _MSC_VER
+    uint64_t high = 0;
+    const uint64_t low = _umul128(a, b, &high);
+    uint64_t remainder = 0;
+    _udiv128(high % mod, low, mod, &remainder);
+    return remainder;
+#else
+    return (uint64_t)(((unsigned __int128)a * b) % mod);
+#endif
+}
 
-    const Factorization& Factorize(BigInt num)
+// Montgomery form arithmetic modulo an odd 64 bit modulus:  values are kept as a * 2^64 mod n,
+// so a modular multiply is two multiplies and a high multiply, with no division.
+class Montgomery64
+{
+public:
+    explicit Montgomery64(uint64_t mod) : m_mod(mod)
     {
-        iterator fiter = find(num);
-        if (fiter == end())
+        assert(mod & 1);
+
+        // Newton iteration for mod^-1 mod 2^64 (each step doubles the number of correct bits)
+        uint64_t inverse = mod;
+        for (BigInt i = 0; i < 5; ++i)
         {
-            fiter = NewFactorize(num);
+            inverse *= 2 - mod * inverse;
         }
+        m_modInverse = inverse;
 
-        return fiter->second;
+        m_one = (0 - mod) % mod;   // 2^64 mod n
+        m_rSquared = CalcMulMod64(m_one, m_one, mod);
     }
 
-private:
-    iterator NewFactorize(BigInt num)
+    uint64_t GetMod() const { return m_mod; }
+    uint64_t GetOne() const { return m_one; }
+
+    uint64_t ToMontgomery(uint64_t a) const { return Multiply(a % m_mod, m_rSquared); }
+    uint64_t FromMontgomery(uint64_t a) const { return Reduce(0, a); }
+
+    uint64_t Multiply(uint64_t a, uint64_t b) const { return Reduce(CalcMulHigh64(a, b), a * b); }
+
+    // plain modular add (works the same on Montgomery form values)
+    uint64_t Add(uint64_t a, uint64_t b) const
     {
-        auto newValue = insert(value_type(num, Factorization()));
-        iterator newIter = newValue.first;
-        Factorization& newFactorization = newIter->second;
+        const uint64_t sum = a + b;
+        return ((sum < a) || (sum >= m_mod)) ? (sum - m_mod) : sum;
+    }
 
-        const BigInt sqrtNum = (BigInt)sqrt(num);
-        BigInt prodRemaining = num;
-        for (BigInt i = 2; i <= sqrtNum; ++i)
+    uint64_t Power(uint64_t base, uint64_t exponent) const
+    {
+        uint64_t result = m_one;
+        while (exponent > 0)
         {
-            const Factorization& f = Factorize(i);
-            if (f.IsPrime())
-            {
-                // i is prime, so see how many i factors fit into this number
-                BigInt numFactors = 0;
-                for (;;)
-                {
-                    const lldiv_t divRem = lldiv(prodRemaining, i);
-                    if (divRem.rem != 0)
-                    {
-                        break;
-                    }
-                    ++numFactors;
-                    prodRemaining = divRem.quot;
-                }
-                if (numFactors > 0)
-                {
-                    newFactorization.emplace(i, numFactors);
-                }
-            }
-
-            if (prodRemaining == 1)
+            if (exponent & 1)
             {
-                break;
+                result = Multiply(result, base);
             }
+            base = Multiply(base, base);
+            exponent >>= 1;
         }
-        if (newFactorization.empty())
-        {
-            newFactorization.emplace(num, 1);
-        }
-
-        return newIter;
+        return result;
     }
-};
 
-static FactorizationCache s_factorizationCache;
-
-void PrintFactorization(BigInt num)
-{
-    printf("%lld:  ", num);
 
-    const Factorization& f = s_factorizationCache.Factorize(num);
-    if (f.IsPrime())
+private:
+    // (high * 2^64 + low) / 2^64 mod n, for inputs below n * 2^64
+    uint64_t Reduce(uint64_t high, uint64_t low) const
     {
-        printf("prime!  ");
+        const uint64_t m = low * m_modInverse;
+        const uint64_t mnHigh = CalcMulHigh64(m, m_mod);
+        return (high >= mnHigh) ? (high - mnHigh) : (high - mnHigh + m_mod);
     }
 
-    f.PrintFactors();
+    uint64_t m_mod;
+    uint64_t m_modInverse;
+    uint64_t m_one;
+    uint64_t m_rSquared;
+};
 
-    printf("\n");
-}
 
-void TestFactorizationRange(BigInt max)
+uint64_t CalcGcd64(uint64_t a, uint64_t b)
 {
-    s_factorizationCache.PopulateCache(max);
+    // binary gcd
+    if ((a == 0) || (b == 0))
+    {
+        return a | b;
+    }
 
-    for (BigInt i = 2; i <= max; ++i)
+    const BigInt shift = CalcLowestSetBit(a | b);
+    a >>= CalcLowestSetBit(a);
+    while (b != 0)
     {
-        PrintFactorization(i);
+        b >>= CalcLowestSetBit(b);
+        if (a > b)
+        {
+            std::swap(a, b);
+        }
+        b -= a;
     }
+    return a << shift;
 }
 
+
 ////////////////////////////
-// PrimeFinder
+// 128 bit integers
 
-class PrimeFinder : public std::vector<BigInt>
+// Just enough unsigned 128 bit arithmetic for big accumulations (like sums of primes past 2^64)
+struct UInt128
 {
-public:
-    PrimeFinder() : std::vector<BigInt>(), m_windowBase(3), m_windowOffset(0)
-    {
-        // start the primes list with 2, and start the window base at the very next value, 3
+    UInt128(uint64_t low = 0) : low(low), high(0) {}
+    UInt128(uint64_t high, uint64_t low) : low(low), high(high) {}
 
-        push_back(2);
-    }
+    static UInt128 CalcProduct(uint64_t a, uint64_t b) { return UInt128(CalcMulHigh64(a, b), a * b); }
 
-    void Reset()
+    UInt128& operator+=(const UInt128& other)
     {
-        clear();
-        push_back(2);
-        m_windowBase = 3;
-        m_windowOffset = 0;
+        const uint64_t newLow = low + other.low;
+        high += other.high + ((newLow < low) ? 1 : 0);
+        low = newLow;
+        return *this;
     }
-
-    void FindPrimes(BigInt windowSize = 128)
+    UInt128& operator-=(const UInt128& other)
     {
-        // reinitialize window
-        std::fill(m_windowFlags.begin(), m_windowFlags.end(), true);
-        m_windowFlags.resize(windowSize, true);
-        assert(std::find(m_windowFlags.begin(), m_windowFlags.end(), false) == m_windowFlags.end());
-        m_windowOffset = 0;
+        const uint64_t newLow = low - other.low;
+        high -= other.high + ((newLow > low) ? 1 : 0);
+        low = newLow;
+        return *this;
+    }
+    UInt128 operator+(const UInt128& other) const { return UInt128(*this) += other; }
+    UInt128 operator-(const UInt128& other) const { return UInt128(*this) -= other; }
 
-        // mark non-primes based on pre-existing primes
-        //printf("Marking non-primes based on previous non-primes\n");
-        for (auto iter = begin(); iter != end(); ++iter)
-        {
-            MarkNonPrimes(*iter);
-        }
+    // (mod 2^128)
+    UInt128 operator*(uint64_t other) const { return UInt128(high * other + CalcMulHigh64(low, other), low * other); }
 
-        // walk through window, adding new primes and marking more non-primes as we go
-        //printf("Walking through window to find more primes\n");
-        const BigInt maxPossiblePrime = m_windowBase + m_windowFlags.size();
-        for (BigInt currPossiblePrime = m_windowBase; currPossiblePrime < maxPossiblePrime; ++currPossiblePrime)
-        {
-            const bool isPrime = m_windowFlags[currPossiblePrime - m_windowBase];
-            m_windowOffset++;
+    bool operator==(const UInt128& other) const { return (low == other.low) && (high == other.high); }
+    bool operator!=(const UInt128& other) const { return !(*this == other); }
 
-            if (isPrime)
+    std::string GetString() const
+    {
+        // long division by 10^9, 32 bits at a time, collecting 9 digit chunks from the bottom up
+        uint32_t limbs[4] = { (uint32_t)(high >> 32), (uint32_t)high, (uint32_t)(low >> 32), (uint32_t)low };
+        std::vector<uint32_t> chunkList;
+        do
+        {
+            uint64_t remainder = 0;
+            for (BigInt i = 0; i < 4; ++i)
             {
-                //printf("%lld is prime!\n", currPossiblePrime);
-                push_back(currPossiblePrime);
-                MarkNonPrimes(currPossiblePrime);
+                const uint64_t current = (remainder << 32) | limbs[i];
+                limbs[i] = (uint32_t)(current / 1000000000);
+                remainder = current % 1000000000;
             }
-            //else {
-            //	printf("%lld is NOT prime!\n", currPossiblePrime);
-            //}
-        }
+            chunkList.push_back((uint32_t)remainder);
+        } while ((limbs[0] | limbs[1] | limbs[2] | limbs[3]) != 0);
 
-        // move window for next time
-        m_windowBase += m_windowFlags.size();
+        std::string st = std::to_string(chunkList.back());
+        for (BigInt i = (BigInt)chunkList.size() - 2; i >= 0; --i)
+        {
+            char chunkString[16];
+            sprintf(chunkString, "%09u", chunkList[i]);
+            st += chunkString;
+        }
+        return st;
     }
 
-    BigInt FindNthPrime(BigInt n)
+    uint64_t low;
+    uint64_t high;
+};
+
+
+////////////////////////////
+// Prime testing
+//
+//      Fast computational testing without caching:  trial division by a few small primes,
+//      then a Miller-Rabin test with a base set that is deterministic for all 64 bit numbers
+//
+
+static const BigInt s_trialDivisionPrimeList[] = { 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53 };
+static const BigInt s_numTrialDivisionPrimes = sizeof(s_trialDivisionPrimeList) / sizeof(s_trialDivisionPrimeList[0]);
+
+// Sinclair's 7 bases, which together have no strong pseudoprime below 2^64
+static const uint64_t s_millerRabinBaseList[] = { 2, 325, 9375, 28178, 450775, 9780504, 1795265022 };
+static const BigInt s_numMillerRabinBases = sizeof(s_millerRabinBaseList) / sizeof(s_millerRabinBaseList[0]);
+
+enum TrialDivisionResult
+{
+    TRIAL_DIVISION_COMPOSITE,
+    TRIAL_DIVISION_PRIME,
+    TRIAL_DIVISION_UNKNOWN,
+};
+
+TrialDivisionResult TrialDivideSmallPrimes(BigInt num)
+{
+    if (num <= 1)
     {
-        const BigInt windowSize = 2 * n;
-        while ((BigInt)size() < n)
-        {
-            FindPrimes(windowSize);
-            //PrintPrimes();
-        }
-        return (*this)[n - 1];
+        return TRIAL_DIVISION_COMPOSITE;
+    }
+    if (num == 2)
+    {
+        return TRIAL_DIVISION_PRIME;
+    }
+    if (!(num & 1))
+    {
+        return TRIAL_DIVISION_COMPOSITE;
     }
 
-    void FindPrimesBelow(BigInt max)
+    for (BigInt i = 0; i < s_numTrialDivisionPrimes; ++i)
     {
-        if (max <= m_windowBase)
+        const BigInt prime = s_trialDivisionPrimeList[i];
+        if (num == prime)
         {
-            Reset();
+            return TRIAL_DIVISION_PRIME;
+        }
+        if (num % prime == 0)
+        {
+            return TRIAL_DIVISION_COMPOSITE;
         }
-
-        FindPrimes(max - m_windowBase);
     }
 
-    void PrintPrimes()
+    // no factor up to the last trial prime, so anything below the next prime squared is prime
+    if (num < 59 * 59)
     {
-        for (auto iter = begin(); iter != end(); ++iter)
-        {
-            printf("%lld ", *iter);
-        }
+        return TRIAL_DIVISION_PRIME;
     }
 
+    return TRIAL_DIVISION_UNKNOWN;
+}
 
-private:
-    void MarkNonPrimes(BigInt num)
+// strong probable prime test of odd num > 2 to the given base
+bool IsStrongProbablePrime(const Montgomery64& mont, uint64_t base)
+{
+    const uint64_t num = mont.GetMod();
+    base %= num;
+    if (base == 0)
     {
-        //printf("Marking non-primes:  num = %lld\n", num);
-        const BigInt firstNum = m_windowBase + m_windowOffset;
-        //printf("firstNum %lld = base %lld + offset %lld\n", firstNum, m_windowBase, m_windowOffset);
+        return true;
+    }
 
-        const auto devRem = lldiv(firstNum, num);
-        //printf("firstNum %lld / %lld =  %lld q, %lld r\n", firstNum, num, devRem.quot, devRem.rem);
+    uint64_t d = num - 1;
+    BigInt s = 0;
+    while (!(d & 1))
+    {
+        d >>= 1;
+        ++s;
+    }
 
-        BigInt firstQuot = devRem.quot;
-        if (devRem.rem > 0)
+    const uint64_t one = mont.GetOne();
+    const uint64_t minusOne = num - one;   // (n - 1) in Montgomery form is n - R mod n
+    uint64_t x = mont.Power(mont.ToMontgomery(base), d);
+    if ((x == one) || (x == minusOne))
+    {
+        return true;
+    }
+
+    for (BigInt i = 1; i < s; ++i)
+    {
+        x = mont.Multiply(x, x);
+        if (x == minusOne)
         {
-            ++firstQuot;
+            return true;
         }
-        //printf("firstQuot = %lld\n", firstQuot);
+    }
 
-        BigInt firstNonPrime = firstQuot * num;
+    return false;
+}
+
+bool IsNumberPrime(BigInt num)
+{
+    const TrialDivisionResult trialResult = TrialDivideSmallPrimes(num);
+    if (trialResult != TRIAL_DIVISION_UNKNOWN)
+    {
+        return (trialResult == TRIAL_DIVISION_PRIME);
+    }
+
+    const Montgomery64 mont((uint64_t)num);
+    for (BigInt i = 0; i < s_numMillerRabinBases; ++i)
+    {
+        if (!IsStrongProbablePrime(mont, s_millerRabinBaseList[i]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Tests a whole list of candidates.  Candidates that survive trial division go through Miller-Rabin
+// one base at a time, several candidates at once, with their modular exponentiations interleaved step by step
+// so the multiplies of one candidate fill in the latency of the multiplies of the others.
+// Only the candidates still passing move on to the next base, which keeps the lanes full.
+void AreNumbersPrime(const BigInt* numList, BigInt numNums, bool* isPrimeList)
+{
+    static const BigInt NUM_LANES = 4;
+
+    struct Candidate
+    {
+        Candidate(BigInt index, uint64_t num) : index(index), mont(num), d(num - 1), s(0), numBits(0)
+        {
+            while (!(d & 1))
+            {
+                d >>= 1;
+                ++s;
+            }
+            while ((numBits < 64) && ((d >> numBits) != 0))
+            {
+                ++numBits;
+            }
+        }
+
+        BigInt index;
+        Montgomery64 mont;
+        uint64_t d;
+        BigInt s;
+        BigInt numBits;
+    };
+
+    std::vector<Candidate> candidateList;
+    for (BigInt i = 0; i < numNums; ++i)
+    {
+        const TrialDivisionResult trialResult = TrialDivideSmallPrimes(numList[i]);
+        isPrimeList[i] = (trialResult == TRIAL_DIVISION_PRIME);
+        if (trialResult == TRIAL_DIVISION_UNKNOWN)
+        {
+            candidateList.emplace_back(i, (uint64_t)numList[i]);
+        }
+    }
+
+    for (BigInt baseIndex = 0; baseIndex < s_numMillerRabinBases; ++baseIndex)
+    {
+        const uint64_t base = s_millerRabinBaseList[baseIndex];
+        const BigInt numCandidates = (BigInt)candidateList.size();
+        BigInt numSurvivors = 0;
+        for (BigInt first = 0; first < numCandidates; first += NUM_LANES)
+        {
+            const BigInt numLanes = std::min(NUM_LANES, numCandidates - first);
+
+            // a short last group just repeats its last candidate, so every group runs the full set of lanes
+            const Candidate* lanes[NUM_LANES];
+            for (BigInt lane = 0; lane < NUM_LANES; ++lane)
+            {
+                lanes[lane] = &candidateList[first + std::min(lane, numLanes - 1)];
+            }
+
+            // left to right exponentiation in lockstep;  high zero bits of the shorter exponents just square one
+            uint64_t baseList[NUM_LANES];
+            uint64_t xList[NUM_LANES];
+            BigInt maxNumBits = 0;
+            for (BigInt lane = 0; lane < NUM_LANES; ++lane)
+            {
+                baseList[lane] = lanes[lane]->mont.ToMontgomery(base);
+                xList[lane] = lanes[lane]->mont.GetOne();
+                maxNumBits = std::max(maxNumBits, lanes[lane]->numBits);
+            }
+            for (BigInt bit = maxNumBits - 1; bit >= 0; --bit)
+            {
+                for (BigInt lane = 0; lane < NUM_LANES; ++lane)
+                {
+                    // always multiply and then select, since the exponent bits are no use to the branch predictor
+                    const uint64_t squared = lanes[lane]->mont.Multiply(xList[lane], xList[lane]);
+                    const uint64_t multiplied = lanes[lane]->mont.Multiply(squared, baseList[lane]);
+                    xList[lane] = ((lanes[lane]->d >> bit) & 1) ? multiplied : squared;
+                }
+            }
+
+            for (BigInt lane = 0; lane < numLanes; ++lane)
+            {
+                const Montgomery64& mont = lanes[lane]->mont;
+                const uint64_t one = mont.GetOne();
+                const uint64_t minusOne = mont.GetMod() - one;
+
+                uint64_t x = xList[lane];
+                bool passed = (baseList[lane] == 0) || (x == one) || (x == minusOne);
+                for (BigInt i = 1; !passed && (i < lanes[lane]->s); ++i)
+                {
+                    x = mont.Multiply(x, x);
+                    passed = (x == minusOne);
+                }
+
+                // survivors are packed down to the front of the list (never past the lane being read)
+                if (passed)
+                {
+                    candidateList[numSurvivors++] = *lanes[lane];
+                }
+            }
+        }
+        candidateList.erase(candidateList.begin() + numSurvivors, candidateList.end());
+    }
+
+    for (auto iter = candidateList.begin(); iter != candidateList.end(); ++iter)
+    {
+        isPrimeList[iter->index] = true;
+    }
+}
+
+
+////////////////////////////
+// Factorization
+
+// A number's prime factors, as (prime, numFactors) pairs sorted by prime and kept inline in a fixed array.
+// The product of the first 16 primes is past 2^64, so no 64 bit number has more than 15 distinct primes.
+// Nothing is allocated, so factorizations can be stored by value anywhere, and copied with memcpy.
+class Factorization
+{
+public:
+    static const BigInt MAX_NUM_PRIMES = 15;
+
+    struct PrimeFactor
+    {
+        BigInt prime;
+        BigInt numFactors;
+    };
+
+    Factorization() : m_numPrimes(0) {}
+
+    BigInt size() const { return m_numPrimes; }
+    bool empty() const { return (m_numPrimes == 0); }
+    void clear() { m_numPrimes = 0; }
+
+    const PrimeFactor* begin() const { return m_primeFactorList; }
+    const PrimeFactor* end() const { return m_primeFactorList + m_numPrimes; }
+    const PrimeFactor& back() const { return m_primeFactorList[m_numPrimes - 1]; }
+
+    bool IsPrime() const { return ((m_numPrimes == 1) && (m_primeFactorList[0].numFactors == 1)); }
+
+    // multiplies in prime^numFactors
+    void AddFactors(BigInt prime, BigInt numFactors)
+    {
+        // factors mostly arrive in increasing order, so look from the top down
+        BigInt index = m_numPrimes;
+        while ((index > 0) && (m_primeFactorList[index - 1].prime > prime))
+        {
+            --index;
+        }
+
+        if ((index > 0) && (m_primeFactorList[index - 1].prime == prime))
+        {
+            m_primeFactorList[index - 1].numFactors += numFactors;
+            return;
+        }
+
+        assert(m_numPrimes < MAX_NUM_PRIMES);
+        memmove(&m_primeFactorList[index + 1], &m_primeFactorList[index], (m_numPrimes - index) * sizeof(PrimeFactor));
+        m_primeFactorList[index].prime = prime;
+        m_primeFactorList[index].numFactors = numFactors;
+        ++m_numPrimes;
+    }
+
+    // becomes the least common multiple:  the larger count of each prime from either side
+    void Absorb(const Factorization& other)
+    {
+        Factorization merged;
+        const PrimeFactor* iter = begin();
+        const PrimeFactor* otherIter = other.begin();
+        while ((iter != end()) || (otherIter != other.end()))
+        {
+            assert(merged.m_numPrimes < MAX_NUM_PRIMES);
+            PrimeFactor& mergedFactor = merged.m_primeFactorList[merged.m_numPrimes++];
+            if ((otherIter == other.end()) || ((iter != end()) && (iter->prime < otherIter->prime)))
+            {
+                mergedFactor = *iter++;
+            }
+            else if ((iter == end()) || (otherIter->prime < iter->prime))
+            {
+                mergedFactor = *otherIter++;
+            }
+            else
+            {
+                mergedFactor.prime = iter->prime;
+                mergedFactor.numFactors = std::max(iter->numFactors, otherIter->numFactors);
+                ++iter;
+                ++otherIter;
+            }
+        }
+
+        *this = merged;
+    }
+
+    BigInt CalcProduct() const
+    {
+        BigInt product = 1;
+        for (auto iter = begin(); iter != end(); ++iter)
+        {
+            for (BigInt i = 0; i < iter->numFactors; ++i)
+            {
+                product *= iter->prime;
+            }
+        }
+        return product;
+    }
+
+    void PrintFactors() const
+    {
+        for (auto iter = begin(); iter != end(); ++iter)
+        {
+            printf("(%lldn of %lld) ", iter->numFactors, iter->prime);
+        }
+    }
+
+    BigInt CalcNumDivisors() const
+    {
+        if (IsPrime())
+        {
+            // if prime, then number of divisors is simply:  1, and itself
+            return 2;
+        }
+
+        BigInt numDivisors = 1;
+        // the number of divisors will be the numbers of combinations of prime factors.
+        // in a given divisor, each prime factor can be included from 0 to N times, where
+        // N is the number of times that prime factor exists in the original number.
+        // (the divisor with ZERO of any prime factors included, is the divisor 1, which every number has.)
+        for (auto iter = begin(); iter != end(); ++iter)
+        {
+            numDivisors *= (iter->numFactors + 1);
+        }
+        // add 1 more for the original number, being one of its own divisors
+        numDivisors += 1;
+
+        return numDivisors;
+    }
+
+    // calls func(divisor) for every divisor (1 and the number itself included), built up from the prime powers, in no particular order
+    template<typename Func>
+    void ForEachDivisor(Func func) const
+    {
+        ForEachDivisorUpTo(MAX_BIG_INT, func);
+    }
+
+    // same, but only for the divisors <= maxDivisor, never stepping into products past it
+    template<typename Func>
+    void ForEachDivisorUpTo(BigInt maxDivisor, Func func) const
+    {
+        if (maxDivisor >= 1)
+        {
+            ForEachDivisorFrom(0, 1, maxDivisor, func);
+        }
+    }
+
+    void CalcDivisors(std::vector<BigInt>& divisorList, bool sorted = true, BigInt maxDivisor = MAX_BIG_INT) const
+    {
+        divisorList.clear();
+        ForEachDivisorUpTo(maxDivisor, [&divisorList](BigInt divisor) { divisorList.push_back(divisor); });
+        if (sorted)
+        {
+            std::sort(divisorList.begin(), divisorList.end());
+        }
+    }
+
+private:
+    // every divisor is (what's been picked from the primes before primeIndex) * (some choice of powers of the rest)
+    template<typename Func>
+    void ForEachDivisorFrom(BigInt primeIndex, BigInt divisor, BigInt maxDivisor, Func& func) const
+    {
+        if (primeIndex == m_numPrimes)
+        {
+            func(divisor);
+            return;
+        }
+
+        const PrimeFactor& primeFactor = m_primeFactorList[primeIndex];
+        for (BigInt k = 0;; ++k)
+        {
+            ForEachDivisorFrom(primeIndex + 1, divisor, maxDivisor, func);
+            if ((k == primeFactor.numFactors) || (divisor > maxDivisor / primeFactor.prime))
+            {
+                break;
+            }
+            divisor *= primeFactor.prime;
+        }
+    }
+
+    BigInt m_numPrimes;
+    PrimeFactor m_primeFactorList[MAX_NUM_PRIMES];
+};
+
+static_assert(std::is_trivially_copyable<Factorization>::value, "Factorization must stay memcpy-able");
+
+////////////////////////////
+// Factorization engine
+//
+//      Trial division by the primes below 1024, then Miller-Rabin and Brent's variant of Pollard's rho
+//      to split whatever is left, so any 64 bit number factors in microseconds
+//
+
+static const BigInt s_factorTrialDivisionLimit = 1024;
+
+const std::vector<BigInt>& GetFactorTrialDivisionPrimes()
+{
+    static std::vector<BigInt> s_primeList;
+    if (s_primeList.empty())
+    {
+        for (BigInt num = 2; num < s_factorTrialDivisionLimit; ++num)
+        {
+            bool isPrime = true;
+            for (auto iter = s_primeList.begin(); (iter != s_primeList.end()) && (*iter * *iter <= num); ++iter)
+            {
+                if (num % *iter == 0)
+                {
+                    isPrime = false;
+                    break;
+                }
+            }
+            if (isPrime)
+            {
+                s_primeList.push_back(num);
+            }
+        }
+    }
+    return s_primeList;
+}
+
+// Finds a nontrivial factor of an odd composite, using Brent's cycle finding on x -> x^2 + c in Montgomery form.
+// The |x - y| differences are multiplied together and only gcd'd with num every FACTOR_BATCH_SIZE steps;
+// if a batch overshoots (gcd == num), it backs up and redoes that batch one gcd at a time.
+uint64_t FindFactorPollardBrent(uint64_t num)
+{
+    static const BigInt FACTOR_BATCH_SIZE = 128;
+
+    assert(num & 1);
+    const Montgomery64 mont(num);
+
+    for (uint64_t c = 1;; ++c)
+    {
+        const uint64_t montC = mont.ToMontgomery(c);
+        auto step = [&mont, montC](uint64_t x) { return mont.Add(mont.Multiply(x, x), montC); };
+
+        uint64_t x = 0;
+        uint64_t y = mont.ToMontgomery(2);
+        uint64_t ys = y;
+        uint64_t product = mont.GetOne();
+        uint64_t factor = 1;
+        for (BigInt cycleLength = 1; factor == 1; cycleLength *= 2)
+        {
+            x = y;
+            for (BigInt i = 0; i < cycleLength; ++i)
+            {
+                y = step(y);
+            }
+
+            for (BigInt k = 0; (k < cycleLength) && (factor == 1); k += FACTOR_BATCH_SIZE)
+            {
+                ys = y;
+                const BigInt batchSize = std::min(FACTOR_BATCH_SIZE, cycleLength - k);
+                for (BigInt i = 0; i < batchSize; ++i)
+                {
+                    y = step(y);
+                    product = mont.Multiply(product, (x > y) ? (x - y) : (y - x));
+                }
+                factor = CalcGcd64(product, num);
+            }
+        }
+
+        if (factor == num)
+        {
+            // the batch product hit zero, so retrace that batch one step at a time
+            do
+            {
+                ys = step(ys);
+                factor = CalcGcd64((x > ys) ? (x - ys) : (ys - x), num);
+            } while (factor == 1);
+        }
+
+        if (factor != num)
+        {
+            return factor;
+        }
+
+        // no luck with this c (x and y met mod every factor at once), so try another
+    }
+}
+
+void AddPollardRhoFactors(uint64_t num, Factorization& f)
+{
+    if (num == 1)
+    {
+        return;
+    }
+
+    if (IsNumberPrime((BigInt)num))
+    {
+        f.AddFactors((BigInt)num, 1);
+        return;
+    }
+
+    const uint64_t factor = FindFactorPollardBrent(num);
+    AddPollardRhoFactors(factor, f);
+    AddPollardRhoFactors(num / factor, f);
+}
+
+Factorization CalcFactorization(BigInt num)
+{
+    Factorization f;
+    if (num <= 1)
+    {
+        return f;
+    }
+
+    const std::vector<BigInt>& primeList = GetFactorTrialDivisionPrimes();
+    for (auto iter = primeList.begin(); iter != primeList.end(); ++iter)
+    {
+        const BigInt prime = *iter;
+        if (prime * prime > num)
+        {
+            break;
+        }
+
+        BigInt numFactors = 0;
+        while (num % prime == 0)
+        {
+            num /= prime;
+            ++numFactors;
+        }
+        if (numFactors > 0)
+        {
+            f.AddFactors(prime, numFactors);
+        }
+    }
+
+    if (num > 1)
+    {
+        if (num < s_factorTrialDivisionLimit * s_factorTrialDivisionLimit)
+        {
+            // no factor below 1024 left, so what remains is prime
+            f.AddFactors(num, 1);
+        }
+        else
+        {
+            AddPollardRhoFactors((uint64_t)num, f);
+        }
+    }
+
+    return f;
+}
+
+// Bump allocator:  hands out 8 byte aligned pieces of big blocks, and only ever frees everything at once
+class Arena
+{
+public:
+    static const BigInt DEFAULT_BLOCK_BYTES = 64 * 1024;
+
+    Arena(BigInt blockBytes = DEFAULT_BLOCK_BYTES) : m_blockWords((blockBytes + 7) / 8), m_blockIndex(0), m_wordIndex(0) {}
+
+    void* Allocate(BigInt numBytes)
+    {
+        const BigInt numWords = (numBytes + 7) / 8;
+        assert(numWords <= m_blockWords);
+        if (m_blockList.empty())
+        {
+            m_blockList.emplace_back(m_blockWords);
+        }
+        else if (m_wordIndex + numWords > m_blockWords)
+        {
+            ++m_blockIndex;
+            if (m_blockIndex == (BigInt)m_blockList.size())
+            {
+                m_blockList.emplace_back(m_blockWords);
+            }
+            m_wordIndex = 0;
+        }
+
+        void* ptr = &m_blockList[m_blockIndex][m_wordIndex];
+        m_wordIndex += numWords;
+        return ptr;
+    }
+
+    // frees everything;  the first block is kept for reuse
+    void Release()
+    {
+        m_blockList.resize(std::min((BigInt)m_blockList.size(), 1LL));
+        m_blockIndex = 0;
+        m_wordIndex = 0;
+    }
+
+    BigInt GetNumBytes() const { return (BigInt)m_blockList.size() * m_blockWords * 8; }
+
+    void Swap(Arena& other)
+    {
+        m_blockList.swap(other.m_blockList);
+        std::swap(m_blockWords, other.m_blockWords);
+        std::swap(m_blockIndex, other.m_blockIndex);
+        std::swap(m_wordIndex, other.m_wordIndex);
+    }
+
+
+private:
+    BigInt m_blockWords;
+    BigInt m_blockIndex;
+    BigInt m_wordIndex;
+    std::vector<std::vector<uint64_t>> m_blockList;
+};
+
+// Factorizations below the smallest-prime-factor (SPF) limit come straight out of a linear sieved table of
+// smallest prime factors, a handful of divisions each with nothing stored.  Anything above the limit
+// is factorized by CalcFactorization and kept, in one of NUM_SHARDS shards picked by a hash of the number.
+// Each shard has its own reader/writer lock, so worker threads can all factorize at once:  lookups only
+// share-lock one shard, and a miss is factorized outside any lock and then inserted under that shard's write lock.
+// Factorizations are handed back by value (they're small and flat), so nothing points into the shards.
+// (Setting or extending the SPF limit is not thread safe;  do that before starting any workers.)
+//
+// Cached entries are packed (just the number and its prime factors) into arenas, with an open addressed index.
+// Each shard keeps two generations, and inserts only go into the young one;  once that has used up its half of the
+// shard's share of the byte budget, the old generation is dropped in one go and the young one becomes the old one.
+class FactorizationCache
+{
+public:
+    static const BigInt MAX_AUTO_SPF_LIMIT = 1LL << 24;
+    static const BigInt NUM_SHARDS_LOG2 = 6;
+    static const BigInt NUM_SHARDS = 1LL << NUM_SHARDS_LOG2;
+    static const BigInt DEFAULT_BYTE_BUDGET = 256LL * 1024 * 1024;
+
+    struct Stats
+    {
+        BigInt numEntries;
+        BigInt numBytes;      // arenas and indices of the cached entries
+        BigInt numSpfBytes;   // the smallest prime factor table
+    };
+
+    FactorizationCache(BigInt byteBudget = DEFAULT_BYTE_BUDGET) { SetByteBudget(byteBudget); }
+
+    // drops everything cached so far
+    void SetByteBudget(BigInt byteBudget)
+    {
+        m_byteBudget = byteBudget;
+
+        // small budgets get small blocks, so the budget still spans a few of them
+        const BigInt generationBudget = std::max(byteBudget / (2 * NUM_SHARDS), 1LL);
+        const BigInt blockBytes = std::max(std::min(generationBudget / 4, (BigInt)Arena::DEFAULT_BLOCK_BYTES), 1024LL);
+        for (BigInt i = 0; i < NUM_SHARDS; ++i)
+        {
+            std::unique_lock<std::shared_timed_mutex> writeLock(m_shardList[i].mutex);
+            for (BigInt g = 0; g < 2; ++g)
+            {
+                Generation& generation = m_shardList[i].generationList[g];
+                Arena(blockBytes).Swap(generation.arena);
+                std::vector<const CacheEntry*>().swap(generation.slotList);
+                generation.numEntries = 0;
+            }
+            m_shardList[i].youngIndex = 0;
+        }
+    }
+
+    BigInt GetByteBudget() const { return m_byteBudget; }
+
+    Stats GetStats() const
+    {
+        Stats stats;
+        stats.numEntries = 0;
+        stats.numBytes = 0;
+        stats.numSpfBytes = (BigInt)(m_spfList.capacity() * sizeof(uint32_t));
+        for (BigInt i = 0; i < NUM_SHARDS; ++i)
+        {
+            std::shared_lock<std::shared_timed_mutex> readLock(m_shardList[i].mutex);
+            for (BigInt g = 0; g < 2; ++g)
+            {
+                const Generation& generation = m_shardList[i].generationList[g];
+                stats.numEntries += generation.numEntries;
+                stats.numBytes += generation.GetNumBytes();
+            }
+        }
+        return stats;
+    }
+
+    void PopulateCache(BigInt num)
+    {
+        if (num < MAX_AUTO_SPF_LIMIT)
+        {
+            ExtendSpfLimit(num + 1);
+        }
+        else
+        {
+            Factorize(num * 2);
+        }
+    }
+
+    BigInt GetSpfLimit() const { return (BigInt)m_spfList.size(); }
+
+    // (re)build the table of smallest prime factors for [0, limit), with a linear sieve:
+    // every composite is crossed off exactly once, as (its smallest prime factor) * (the rest)
+    void SetSpfLimit(BigInt limit)
+    {
+        assert(limit <= (BigInt)UINT32_MAX);
+        m_spfList.assign(std::max(limit, 0LL), 0);
+
+        std::vector<uint32_t> primeList;
+        for (BigInt i = 2; i < limit; ++i)
+        {
+            if (m_spfList[i] == 0)
+            {
+                m_spfList[i] = (uint32_t)i;
+                primeList.push_back((uint32_t)i);
+            }
+
+            const BigInt spf = m_spfList[i];
+            for (auto iter = primeList.begin(); (iter != primeList.end()) && (*iter <= spf) && (i * *iter < limit); ++iter)
+            {
+                m_spfList[i * *iter] = *iter;
+            }
+        }
+    }
+
+    void ExtendSpfLimit(BigInt limit)
+    {
+        if (limit > GetSpfLimit())
+        {
+            SetSpfLimit(limit);
+        }
+    }
+
+    // calls func(prime, numFactors) for each prime factor of num, in increasing order
+    template<typename Func>
+    void ForEachPrimeFactor(BigInt num, Func func)
+    {
+        if ((num > 1) && (num < GetSpfLimit()))
+        {
+            while (num > 1)
+            {
+                const BigInt prime = m_spfList[num];
+                BigInt numFactors = 0;
+                do
+                {
+                    num /= prime;
+                    ++numFactors;
+                } while (m_spfList[num] == prime);
+                func(prime, numFactors);
+            }
+            return;
+        }
+
+        const Factorization f = Factorize(num);
+        for (auto iter = f.begin(); iter != f.end(); ++iter)
+        {
+            func(iter->prime, iter->numFactors);
+        }
+    }
+
+    Factorization Factorize(BigInt num)
+    {
+        Factorization f;
+        if ((num > 1) && (num < GetSpfLimit()))
+        {
+            ForEachPrimeFactor(num, [&f](BigInt prime, BigInt numFactors) { f.AddFactors(prime, numFactors); });
+            return f;
+        }
+
+        Shard& shard = m_shardList[CalcShardIndex(num)];
+        {
+            std::shared_lock<std::shared_timed_mutex> readLock(shard.mutex);
+            for (BigInt g = 0; g < 2; ++g)
+            {
+                const CacheEntry* entry = shard.generationList[(shard.youngIndex + g) & 1].Find(num);
+                if (entry)
+                {
+                    entry->GetFactorization(f);
+                    return f;
+                }
+            }
+        }
+
+        f = CalcFactorization(num);
+        if (f.empty())
+        {
+            f.AddFactors(num, 1);
+        }
+
+        // (another thread may have got there first, in which case this is the same answer)
+        std::unique_lock<std::shared_timed_mutex> writeLock(shard.mutex);
+        Generation* young = &shard.generationList[shard.youngIndex];
+        if (young->Find(num))
+        {
+            return f;
+        }
+        if (young->GetNumBytes() >= m_byteBudget / (2 * NUM_SHARDS))
+        {
+            shard.youngIndex ^= 1;
+            young = &shard.generationList[shard.youngIndex];
+            young->Clear();
+        }
+        young->Insert(num, f);
+
+        return f;
+    }
+
+private:
+    // packed into an arena as this header followed directly by its prime factors
+    struct CacheEntry
+    {
+        BigInt num;
+        BigInt numPrimes;
+
+        const Factorization::PrimeFactor* GetPrimeFactors() const
+        {
+            return reinterpret_cast<const Factorization::PrimeFactor*>(this + 1);
+        }
+
+        void GetFactorization(Factorization& f) const
+        {
+            f.clear();
+            const Factorization::PrimeFactor* primeFactorList = GetPrimeFactors();
+            for (BigInt i = 0; i < numPrimes; ++i)
+            {
+                f.AddFactors(primeFactorList[i].prime, primeFactorList[i].numFactors);
+            }
+        }
+    };
+
+    // entries in an arena, indexed by an open addressed (linear probing) table of pointers to them
+    struct Generation
+    {
+        Arena arena;
+        std::vector<const CacheEntry*> slotList;
+        BigInt numEntries;
+
+        Generation() : numEntries(0) {}
+
+        BigInt GetNumBytes() const { return arena.GetNumBytes() + (BigInt)(slotList.capacity() * sizeof(const CacheEntry*)); }
+
+        const CacheEntry* Find(BigInt num) const
+        {
+            if (slotList.empty())
+            {
+                return nullptr;
+            }
+
+            const BigInt slotMask = (BigInt)slotList.size() - 1;
+            for (BigInt slot = CalcSlotHash(num) & slotMask;; slot = (slot + 1) & slotMask)
+            {
+                const CacheEntry* entry = slotList[slot];
+                if (!entry || (entry->num == num))
+                {
+                    return entry;
+                }
+            }
+        }
+
+        void Insert(BigInt num, const Factorization& f)
+        {
+            // keep the index at most half full
+            if (2 * (numEntries + 1) > (BigInt)slotList.size())
+            {
+                std::vector<const CacheEntry*> oldSlotList(std::max(2 * (BigInt)slotList.size(), 16LL), nullptr);
+                oldSlotList.swap(slotList);
+                for (auto iter = oldSlotList.begin(); iter != oldSlotList.end(); ++iter)
+                {
+                    if (*iter)
+                    {
+                        PlaceInSlot(*iter);
+                    }
+                }
+            }
+
+            const BigInt numBytes = (BigInt)(sizeof(CacheEntry) + f.size() * sizeof(Factorization::PrimeFactor));
+            CacheEntry* entry = static_cast<CacheEntry*>(arena.Allocate(numBytes));
+            entry->num = num;
+            entry->numPrimes = f.size();
+            memcpy(entry + 1, f.begin(), f.size() * sizeof(Factorization::PrimeFactor));
+
+            PlaceInSlot(entry);
+            ++numEntries;
+        }
+
+        void Clear()
+        {
+            arena.Release();
+            std::vector<const CacheEntry*>().swap(slotList);
+            numEntries = 0;
+        }
+
+        void PlaceInSlot(const CacheEntry* entry)
+        {
+            const BigInt slotMask = (BigInt)slotList.size() - 1;
+            BigInt slot = CalcSlotHash(entry->num) & slotMask;
+            while (slotList[slot])
+            {
+                slot = (slot + 1) & slotMask;
+            }
+            slotList[slot] = entry;
+        }
+
+        static BigInt CalcSlotHash(BigInt num)
+        {
+            // a different multiplier from the shard hash, since every number in a shard shares its top bits of that one
+            const uint64_t hash = (uint64_t)num * 0xC2B2AE3D27D4EB4FULL;
+            return (BigInt)(hash >> 32);
+        }
+    };
+
+    struct Shard
+    {
+        mutable std::shared_timed_mutex mutex;
+        Generation generationList[2];
+        BigInt youngIndex;
+    };
+
+    static BigInt CalcShardIndex(BigInt num)
+    {
+        // Fibonacci hashing, so runs of consecutive (or all even) numbers still spread over every shard
+        return (BigInt)(((uint64_t)num * 0x9E3779B97F4A7C15ULL) >> (64 - NUM_SHARDS_LOG2));
+    }
+
+    std::vector<uint32_t> m_spfList;
+    BigInt m_byteBudget;
+    Shard m_shardList[NUM_SHARDS];
+};
+
+static FactorizationCache s_factorizationCache;
+
+void PrintFactorization(BigInt num, const Factorization& f)
+{
+    printf("%lld:  ", num);
+
+    if (f.IsPrime())
+    {
+        printf("prime!  ");
+    }
+
+    f.PrintFactors();
+
+    printf("\n");
+}
+
+void PrintFactorization(BigInt num)
+{
+    PrintFactorization(num, s_factorizationCache.Factorize(num));
+}
+
+// several threads factorizing the same (overlapping) numbers through one cache at once
+void TestFactorizationCacheThreads(BigInt lo, BigInt numNums, BigInt numThreads)
+{
+    FactorizationCache cache;
+    std::atomic<BigInt> numMismatches(0);
+
+    std::vector<std::thread> threadList;
+    for (BigInt t = 0; t < numThreads; ++t)
+    {
+        threadList.emplace_back([&cache, &numMismatches, lo, numNums, t]() {
+            // each thread starts at a different point, so they keep both missing and hitting each other's entries
+            for (BigInt i = 0; i < numNums; ++i)
+            {
+                const BigInt num = lo + (i + t * numNums / 4) % numNums;
+                if (cache.Factorize(num).CalcProduct() != num)
+                {
+                    ++numMismatches;
+                }
+            }
+        });
+    }
+    for (auto iter = threadList.begin(); iter != threadList.end(); ++iter)
+    {
+        iter->join();
+    }
+
+    const FactorizationCache::Stats stats = cache.GetStats();
+    printf(
+        "Factorization cache with %lld threads:  %lld numbers cached in %lld bytes, %lld mismatches\n",
+        numThreads,
+        stats.numEntries,
+        stats.numBytes,
+        (BigInt)numMismatches);
+}
+
+// runs a long stream of distinct numbers through a cache with a small budget, which has to keep evicting
+void TestFactorizationCacheBudget(BigInt byteBudget)
+{
+    FactorizationCache cache(byteBudget);
+
+    BigInt numMismatches = 0;
+    BigInt maxNumBytes = 0;
+    for (BigInt num = 1000000000000LL; num < 1000000000000LL + 200000; ++num)
+    {
+        // revisit a recent number every so often, which should mostly still be cached
+        const BigInt lookupNum = (num & 7) ? num : num - 1000;
+        if (cache.Factorize(lookupNum).CalcProduct() != lookupNum)
+        {
+            ++numMismatches;
+        }
+        if ((num & 0xfff) == 0)
+        {
+            maxNumBytes = std::max(maxNumBytes, cache.GetStats().numBytes);
+        }
+    }
+
+    const FactorizationCache::Stats stats = cache.GetStats();
+    printf(
+        "Factorization cache with a %lld byte budget:  %lld numbers cached in %lld bytes (peak %lld), %lld mismatches\n",
+        byteBudget,
+        stats.numEntries,
+        stats.numBytes,
+        maxNumBytes,
+        numMismatches);
+}
+
+////////////////////////////
+// Multiplicative functions
+//
+//      Linear sieve filling in a table of f(n) for n = 1..max in O(max), for any multiplicative f,
+//      from just its values on prime powers
+//
+
+// primePowerFunc(prime, exponent, primePower) returns f(p^k);  table[0] is left as 0
+template<typename Value, typename PrimePowerFunc>
+void CalcMultiplicativeTable(BigInt max, PrimePowerFunc primePowerFunc, std::vector<Value>& table)
+{
+    assert(max < (BigInt)UINT32_MAX);
+    table.assign(std::max(max + 1, 0LL), Value(0));
+    if (max < 1)
+    {
+        return;
+    }
+    table[1] = Value(1);
+
+    // for every n, the power of its smallest prime which exactly divides it, and the exponent of that power,
+    // so f(n) = f(n / lowPower) * f(lowPower)
+    std::vector<uint32_t> lowPowerList(max + 1, 0);
+    std::vector<uint8_t> lowExponentList(max + 1, 0);
+    std::vector<uint32_t> primeList;
+    for (BigInt i = 2; i <= max; ++i)
+    {
+        if (lowPowerList[i] == 0)
+        {
+            lowPowerList[i] = (uint32_t)i;
+            lowExponentList[i] = 1;
+            table[i] = primePowerFunc(i, 1LL, i);
+            primeList.push_back((uint32_t)i);
+        }
+
+        // every composite is reached exactly once, as its smallest prime times the rest
+        for (auto iter = primeList.begin(); (iter != primeList.end()) && (i * *iter <= max); ++iter)
+        {
+            const BigInt prime = *iter;
+            const BigInt num = i * prime;
+            if (i % prime == 0)
+            {
+                const BigInt lowPower = lowPowerList[i] * prime;
+                const BigInt lowExponent = lowExponentList[i] + 1;
+                lowPowerList[num] = (uint32_t)lowPower;
+                lowExponentList[num] = (uint8_t)lowExponent;
+                table[num] = (lowPower == num) ? primePowerFunc(prime, lowExponent, lowPower) : table[num / lowPower] * table[lowPower];
+                break;
+            }
+
+            lowPowerList[num] = (uint32_t)prime;
+            lowExponentList[num] = 1;
+            table[num] = table[i] * table[prime];
+        }
+    }
+}
+
+// tau(n), the number of divisors
+void CalcDivisorCountTable(BigInt max, std::vector<BigInt>& table)
+{
+    CalcMultiplicativeTable(max, [](BigInt, BigInt exponent, BigInt) { return exponent + 1; }, table);
+}
+
+// sigma(n), the sum of the divisors (including n)
+void CalcDivisorSumTable(BigInt max, std::vector<BigInt>& table)
+{
+    // 1 + p + ... + p^k
+    CalcMultiplicativeTable(
+        max, [](BigInt prime, BigInt, BigInt primePower) { return (primePower - 1) / (prime - 1) + primePower; }, table);
+}
+
+// phi(n), Euler's totient
+void CalcTotientTable(BigInt max, std::vector<BigInt>& table)
+{
+    CalcMultiplicativeTable(max, [](BigInt prime, BigInt, BigInt primePower) { return primePower - primePower / prime; }, table);
+}
+
+// mu(n), the Mobius function
+void CalcMobiusTable(BigInt max, std::vector<int8_t>& table)
+{
+    CalcMultiplicativeTable(max, [](BigInt, BigInt exponent, BigInt) { return (int8_t)((exponent == 1) ? -1 : 0); }, table);
+}
+
+void TestMultiplicativeTables(BigInt max)
+{
+    std::vector<BigInt> divisorCountTable;
+    std::vector<BigInt> divisorSumTable;
+    std::vector<BigInt> totientTable;
+    std::vector<int8_t> mobiusTable;
+    CalcDivisorCountTable(max, divisorCountTable);
+    CalcDivisorSumTable(max, divisorSumTable);
+    CalcTotientTable(max, totientTable);
+    CalcMobiusTable(max, mobiusTable);
+
+    // check against the definitions, straight off each number's factorization
+    BigInt numMismatches = 0;
+    for (BigInt n = 1; n <= max; ++n)
+    {
+        BigInt divisorCount = 1;
+        BigInt divisorSum = 1;
+        BigInt totient = n;
+        BigInt mobius = 1;
+        const Factorization f = CalcFactorization(n);
+        for (auto iter = f.begin(); iter != f.end(); ++iter)
+        {
+            BigInt primePowerSum = 1;
+            BigInt primePower = 1;
+            for (BigInt k = 0; k < iter->numFactors; ++k)
+            {
+                primePower *= iter->prime;
+                primePowerSum += primePower;
+            }
+
+            divisorCount *= iter->numFactors + 1;
+            divisorSum *= primePowerSum;
+            totient = totient / iter->prime * (iter->prime - 1);
+            mobius = (iter->numFactors == 1) ? -mobius : 0;
+        }
+
+        if ((divisorCountTable[n] != divisorCount) || (divisorSumTable[n] != divisorSum) || (totientTable[n] != totient) ||
+            (mobiusTable[n] != mobius))
+        {
+            ++numMismatches;
+        }
+    }
+
+    printf("Multiplicative function tables (tau, sigma, phi, mu) checked up to %lld:  %lld mismatches\n", max, numMismatches);
+}
+
+////////////////////////////
+// Divisor sums
+
+// sigma(num), the sum of all the divisors of num (including num), from its factorization
+BigInt CalcSumDivisors(BigInt num)
+{
+    if (num <= 1)
+    {
+        return std::max(num, 0LL);
+    }
+
+    BigInt sum = 1;
+    s_factorizationCache.ForEachPrimeFactor(num, [&sum](BigInt prime, BigInt numFactors) {
+        // 1 + p + ... + p^k
+        BigInt primePowerSum = 1;
+        for (BigInt k = 0; k < numFactors; ++k)
+        {
+            primePowerSum = primePowerSum * prime + 1;
+        }
+        sum *= primePowerSum;
+    });
+
+    return sum;
+}
+
+// table[n] = sum of the proper divisors of n, for 0 <= n < max (with 0 for both 0 and 1).
+// Each divisor pair d * q = n with d <= q is added at once, sieving d up to sqrt(n),
+// a cache-sized block of the table at a time, so each block sees every small divisor while it's hot.
+void CalcSumProperDivisorsTable(BigInt max, std::vector<BigInt>& table)
+{
+    static const BigInt s_blockSize = 32 * 1024;
+
+    table.assign(std::max(max, 0LL), 0);
+    for (BigInt blockLo = 0; blockLo < max; blockLo += s_blockSize)
+    {
+        const BigInt blockHi = std::min(blockLo + s_blockSize, max);
+        BigInt* block = &table[blockLo];
+        for (BigInt d = 1; d * d < blockHi; ++d)
+        {
+            // first multiple of d in the block, starting no lower than d^2 (which pairs d with itself)
+            BigInt q = std::max(d, (blockLo + d - 1) / d);
+            if (q == d)
+            {
+                block[d * d - blockLo] += d;
+                ++q;
+            }
+            for (BigInt num = d * q; num < blockHi; num += d, ++q)
+            {
+                block[num - blockLo] += d + q;
+            }
+        }
+
+        // that was sigma(n), so take n itself back off
+        for (BigInt num = std::max(blockLo, 1LL); num < blockHi; ++num)
+        {
+            block[num - blockLo] -= num;
+        }
+    }
+}
+
+void TestSumProperDivisorsTable(BigInt max)
+{
+    std::vector<BigInt> table;
+    CalcSumProperDivisorsTable(max, table);
+
+    BigInt numMismatches = 0;
+    for (BigInt num = 1; num < max; ++num)
+    {
+        if (table[num] != CalcSumDivisors(num) - num)
+        {
+            ++numMismatches;
+        }
+    }
+
+    printf("Proper divisor sum table checked up to %lld:  %lld mismatches\n", max, numMismatches);
+}
+
+void TestDivisorEnumeration(BigInt max)
+{
+    BigInt numMismatches = 0;
+    std::vector<BigInt> divisorList;
+    std::vector<BigInt> boundedDivisorList;
+    for (BigInt num = 1; num <= max; ++num)
+    {
+        const Factorization f = CalcFactorization(num);
+        f.CalcDivisors(divisorList);
+        f.CalcDivisors(boundedDivisorList, true, CalcSqrtFloor(num));
+
+        // check against trial division, and the sqrt-bounded list against the low half of the full one
+        BigInt numFound = 0;
+        BigInt numLow = 0;
+        for (BigInt d = 1; d <= num; ++d)
+        {
+            if (num % d == 0)
+            {
+                if ((numFound >= (BigInt)divisorList.size()) || (divisorList[numFound] != d))
+                {
+                    ++numMismatches;
+                    break;
+                }
+                ++numFound;
+                numLow += (d * d <= num);
+            }
+        }
+        if ((numFound != (BigInt)divisorList.size()) ||
+            !std::equal(boundedDivisorList.begin(), boundedDivisorList.end(), divisorList.begin()) ||
+            ((BigInt)boundedDivisorList.size() != numLow))
+        {
+            ++numMismatches;
+        }
+    }
+
+    printf("Divisor enumeration checked up to %lld:  %lld mismatches\n", max, numMismatches);
+}
+
+////////////////////////////
+// Multiplicative order
+
+// the smallest k > 0 with base^k = 1 (mod mod), for an odd mod > 1 coprime to base.
+// k divides phi(mod) (which comes from mod's factorization), so start from phi and keep dividing out
+// each prime factor of it for as long as the power still comes out to 1.
+BigInt CalcMultiplicativeOrder(BigInt base, BigInt mod)
+{
+    assert((mod > 1) && (mod & 1));
+
+    // phi(p^k) = p^(k - 1) * (p - 1)
+    Factorization phiFactorization;
+    s_factorizationCache.ForEachPrimeFactor(mod, [&phiFactorization](BigInt prime, BigInt numFactors) {
+        if (numFactors > 1)
+        {
+            phiFactorization.AddFactors(prime, numFactors - 1);
+        }
+        s_factorizationCache.ForEachPrimeFactor(prime - 1, [&phiFactorization](BigInt subPrime, BigInt subNumFactors) {
+            phiFactorization.AddFactors(subPrime, subNumFactors);
+        });
+    });
+
+    const Montgomery64 mont((uint64_t)mod);
+    const uint64_t montBase = mont.ToMontgomery((uint64_t)(base % mod));
+    BigInt order = phiFactorization.CalcProduct();
+    for (auto iter = phiFactorization.begin(); iter != phiFactorization.end(); ++iter)
+    {
+        for (BigInt i = 0; i < iter->numFactors; ++i)
+        {
+            if (mont.Power(montBase, (uint64_t)(order / iter->prime)) != mont.GetOne())
+            {
+                break;
+            }
+            order /= iter->prime;
+        }
+    }
+
+    return order;
+}
+
+////////////////////////////
+// Segmented sieve
+
+// Plain sieve of Eratosthenes for the small table of base primes (up to sqrt of the range being sieved)
+void FindBasePrimes(BigInt max, std::vector<BigInt>& primeList)
+{
+    primeList.clear();
+    if (max < 2)
+    {
+        return;
+    }
+
+    std::vector<char> compositeFlags(max + 1, 0);
+    for (BigInt i = 2; i <= max; ++i)
+    {
+        if (compositeFlags[i])
+        {
+            continue;
+        }
+
+        primeList.push_back(i);
+        for (BigInt j = i * i; j <= max; j += i)
+        {
+            compositeFlags[j] = 1;
+        }
+    }
+}
+
+// Sieves the range [lo, hi) one cache-sized segment at a time.
+// Only odd numbers are stored, one bit each, so a 32KB segment covers a span of 512K numbers.
+// Each base prime carries its next odd multiple over from one segment to the next,
+// and crossing off starts at p^2, so no prime ever re-marks work done by a previous segment.
+class OddSegmentSieve
+{
+public:
+    static const BigInt DEFAULT_SEGMENT_BYTES = 32 * 1024;
+    static const BigInt SEGMENT_SPAN = DEFAULT_SEGMENT_BYTES * 8 * 2;
+
+    OddSegmentSieve(BigInt segmentBytes = DEFAULT_SEGMENT_BYTES)
+        : m_segmentMaxBits(segmentBytes * 8), m_lo(0), m_hi(0), m_nextLo(0), m_segmentLo(0), m_segmentNumBits(0), m_segmentHasTwo(false)
+    {
+    }
+
+    // basePrimes must include every prime up to sqrt(hi - 1)
+    void Init(BigInt lo, BigInt hi, const std::vector<BigInt>& basePrimes)
+    {
+        m_lo = std::max(lo, 0LL);
+        m_hi = hi;
+        m_nextLo = (m_lo <= 2) ? 1 : (m_lo | 1);
+        m_segmentNumBits = 0;
+
+        m_primeList.clear();
+        m_nextMultipleList.clear();
+        for (auto iter = basePrimes.begin(); iter != basePrimes.end(); ++iter)
+        {
+            const BigInt prime = *iter;
+            if (prime == 2)
+            {
+                continue;
+            }
+            if (prime * prime >= hi)
+            {
+                break;
+            }
+
+            // first odd multiple of this prime that is both in range and at least p^2
+            BigInt firstMultiple = std::max(prime * prime, ((m_nextLo + prime - 1) / prime) * prime);
+            if (!(firstMultiple & 1))
+            {
+                firstMultiple += prime;
+            }
+
+            m_primeList.push_back(prime);
+            m_nextMultipleList.push_back(firstMultiple);
+        }
+    }
+
+    bool SieveNextSegment()
+    {
+        if (m_nextLo >= m_hi)
+        {
+            return false;
+        }
+
+        // bit i of the segment represents the odd number m_segmentLo + 2i
+        m_segmentLo = m_nextLo;
+        m_segmentNumBits = std::min(m_segmentMaxBits, (m_hi - m_segmentLo + 1) / 2);
+        m_nextLo = m_segmentLo + 2 * m_segmentNumBits;
+        m_segmentHasTwo = (m_segmentLo <= 3) && (m_lo <= 2) && (m_hi > 2);
+
+        m_bits.assign((m_segmentNumBits + 63) / 64, ~0ULL);
+        const BigInt numTailBits = m_segmentNumBits & 63;
+        if (numTailBits > 0)
+        {
+            m_bits.back() = (1ULL << numTailBits) - 1;
+        }
+        if (m_segmentLo == 1)
+        {
+            // 1 is not prime
+            m_bits[0] &= ~1ULL;
+        }
+
+        uint64_t* bits = m_bits.data();
+        const BigInt numPrimes = (BigInt)m_primeList.size();
+        for (BigInt i = 0; i < numPrimes; ++i)
+        {
+            const BigInt prime = m_primeList[i];
+            BigInt index = (m_nextMultipleList[i] - m_segmentLo) / 2;
+            for (; index < m_segmentNumBits; index += prime)
+            {
+                bits[index >> 6] &= ~(1ULL << (index & 63));
+            }
+            m_nextMultipleList[i] = m_segmentLo + 2 * index;
+        }
+
+        return true;
+    }
+
+    BigInt GetSegmentLo() const { return m_segmentLo; }
+    BigInt GetSegmentHi() const { return std::min(m_segmentLo + 2 * m_segmentNumBits, m_hi); }
+
+    template<typename Func>
+    void ForEachPrime(Func func) const
+    {
+        if (m_segmentHasTwo)
+        {
+            func(2);
+        }
+
+        const BigInt numWords = (BigInt)m_bits.size();
+        for (BigInt w = 0; w < numWords; ++w)
+        {
+            uint64_t word = m_bits[w];
+            while (word != 0)
+            {
+                func(m_segmentLo + 2 * (w * 64 + CalcLowestSetBit(word)));
+                word &= word - 1;
+            }
+        }
+    }
+
+    BigInt CountPrimes() const
+    {
+        BigInt count = m_segmentHasTwo ? 1 : 0;
+        for (auto iter = m_bits.begin(); iter != m_bits.end(); ++iter)
+        {
+            count += CalcPopCount(*iter);
+        }
+        return count;
+    }
+
+
+private:
+    BigInt m_segmentMaxBits;
+    BigInt m_lo;
+    BigInt m_hi;
+    BigInt m_nextLo;
+    BigInt m_segmentLo;
+    BigInt m_segmentNumBits;
+    bool m_segmentHasTwo;
+    std::vector<uint64_t> m_bits;
+    std::vector<BigInt> m_primeList;
+    std::vector<BigInt> m_nextMultipleList;
+};
+
+// Sieves the range [lo, hi) one cache-sized segment at a time, storing only the numbers coprime to 30:
+// each byte covers 30 numbers, with one bit for each of the 8 residues 1, 7, 11, 13, 17, 19, 23, 29.
+// Multiples of 2, 3 and 5 are never stored, and multiples of 7, 11 and 13 are stamped into each segment
+// from a precomputed pattern (which repeats every 7 * 11 * 13 bytes), so crossing off starts at 17.
+// Each base prime walks its multiples p * k with k stepping around the mod 30 wheel, which moves through
+// a fixed cycle of byte steps and bit masks (depending only on p mod 30), and carries its next byte
+// and wheel position over from one segment to the next.
+class WheelSegmentSieve
+{
+public:
+    static const BigInt DEFAULT_SEGMENT_BYTES = 32 * 1024;
+    static const BigInt SEGMENT_SPAN = DEFAULT_SEGMENT_BYTES * 30;
+    static const BigInt WHEEL_SIZE = 30;
+    static const BigInt NUM_WHEEL_RESIDUES = 8;
+    static const BigInt PRESIEVE_PATTERN_SIZE = 7 * 11 * 13;
+
+    WheelSegmentSieve(BigInt segmentBytes = DEFAULT_SEGMENT_BYTES)
+        : m_segmentMaxBytes(segmentBytes), m_lo(0), m_hi(0), m_nextLo(0), m_segmentLo(0), m_segmentNumBytes(0)
+    {
+    }
+
+    // basePrimes must include every prime up to sqrt(hi - 1)
+    void Init(BigInt lo, BigInt hi, const std::vector<BigInt>& basePrimes)
+    {
+        m_lo = std::max(lo, 0LL);
+        m_hi = hi;
+        m_nextLo = (m_lo / WHEEL_SIZE) * WHEEL_SIZE;
+        m_segmentNumBytes = 0;
+        m_segmentSmallPrimeList.clear();
+
+        m_primeList.clear();
+        m_nextByteList.clear();
+        m_wheelIndexList.clear();
+        for (auto iter = basePrimes.begin(); iter != basePrimes.end(); ++iter)
+        {
+            const BigInt prime = *iter;
+            if (prime <= 13)
+            {
+                continue;
+            }
+            if (prime * prime >= hi)
+            {
+                break;
+            }
+
+            // first multiplier k coprime to 30 with p * k both in range and at least p^2
+            BigInt k = std::max(prime, (m_nextLo + prime - 1) / prime);
+            k += GetWheelTables().nextCoprimeGapList[k % WHEEL_SIZE];
+
+            m_primeList.push_back(prime);
+            m_nextByteList.push_back(prime * k / WHEEL_SIZE);
+            m_wheelIndexList.push_back(GetWheelTables().residueIndexList[k % WHEEL_SIZE]);
+        }
+    }
+
+    bool SieveNextSegment()
+    {
+        if (m_nextLo >= m_hi)
+        {
+            return false;
+        }
+
+        // byte b of the segment covers the numbers m_segmentLo + 30b through m_segmentLo + 30b + 29
+        const WheelTables& tables = GetWheelTables();
+        m_segmentLo = m_nextLo;
+        m_segmentNumBytes = std::min(m_segmentMaxBytes, (m_hi - m_segmentLo + WHEEL_SIZE - 1) / WHEEL_SIZE);
+        m_nextLo = m_segmentLo + WHEEL_SIZE * m_segmentNumBytes;
+        m_segmentSmallPrimeList.clear();
+
+        // stamp in the multiples of 7, 11 and 13, padding out to whole 64 bit words with zeroes
+        m_bytes.assign(((m_segmentNumBytes + 7) / 8) * 8, 0);
+        BigInt patternIndex = (m_segmentLo / WHEEL_SIZE) % PRESIEVE_PATTERN_SIZE;
+        for (BigInt byteIndex = 0; byteIndex < m_segmentNumBytes;)
+        {
+            const BigInt numBytes = std::min(PRESIEVE_PATTERN_SIZE - patternIndex, m_segmentNumBytes - byteIndex);
+            memcpy(&m_bytes[byteIndex], &tables.presievePattern[patternIndex], numBytes);
+            byteIndex += numBytes;
+            patternIndex = 0;
+        }
+
+        if (m_segmentLo == 0)
+        {
+            // 1 is not prime, but 7, 11 and 13 are, and 2, 3 and 5 are not stored at all
+            m_bytes[0] = (m_bytes[0] & ~1) | (1 << 1) | (1 << 2) | (1 << 3);
+            static const BigInt s_unstoredPrimeList[] = { 2, 3, 5 };
+            for (BigInt i = 0; i < 3; ++i)
+            {
+                if ((s_unstoredPrimeList[i] >= m_lo) && (s_unstoredPrimeList[i] < m_hi))
+                {
+                    m_segmentSmallPrimeList.push_back(s_unstoredPrimeList[i]);
+                }
+            }
+        }
+
+        // clear out anything before lo or from hi on, in the partial first and last bytes
+        ClearBitsOutsideRange();
+
+        uint8_t* bytes = m_bytes.data();
+        const BigInt segmentFirstByte = m_segmentLo / WHEEL_SIZE;
+        const BigInt numPrimes = (BigInt)m_primeList.size();
+        for (BigInt i = 0; i < numPrimes; ++i)
+        {
+            const BigInt prime = m_primeList[i];
+            const BigInt primeQuot = prime / WHEEL_SIZE;
+            const BigInt primeClass = tables.residueIndexList[prime % WHEEL_SIZE];
+            const BigInt* stepCorrections = tables.stepCorrectionList[primeClass];
+            const uint8_t* stepClearMasks = tables.stepClearMaskList[primeClass];
+
+            BigInt byteIndex = m_nextByteList[i] - segmentFirstByte;
+            BigInt wheelIndex = m_wheelIndexList[i];
+            while (byteIndex < m_segmentNumBytes)
+            {
+                bytes[byteIndex] &= stepClearMasks[wheelIndex];
+                byteIndex += primeQuot * tables.wheelGapList[wheelIndex] + stepCorrections[wheelIndex];
+                wheelIndex = (wheelIndex + 1) & (NUM_WHEEL_RESIDUES - 1);
+            }
+            m_nextByteList[i] = byteIndex + segmentFirstByte;
+            m_wheelIndexList[i] = wheelIndex;
+        }
+
+        return true;
+    }
+
+    BigInt GetSegmentLo() const { return std::max(m_segmentLo, m_lo); }
+    BigInt GetSegmentHi() const { return std::min(m_segmentLo + WHEEL_SIZE * m_segmentNumBytes, m_hi); }
+
+    // raw segment bits:  byte b covers the numbers 30 * (GetSegmentFirstByte() + b) + residue
+    const uint8_t* GetSegmentBytes() const { return m_bytes.data(); }
+    BigInt GetSegmentNumBytes() const { return m_segmentNumBytes; }
+    BigInt GetSegmentFirstByte() const { return m_segmentLo / WHEEL_SIZE; }
+    // the segment bytes are padded out to whole 64 bit words with zeroes
+    BigInt GetSegmentNumWords() const { return (BigInt)m_bytes.size() / 8; }
+    // 2, 3 and 5 (when in range), which are not in the segment bits
+    const std::vector<BigInt>& GetSegmentSmallPrimes() const { return m_segmentSmallPrimeList; }
+
+    // residue mod 30 of a bit index within a byte
+    static BigInt GetBitResidue(BigInt bitIndex) { return GetWheelTables().residueList[bitIndex]; }
+
+    // bit index of a residue mod 30 within its byte, or -1 if the residue is not coprime to 30
+    static BigInt GetResidueBitIndex(BigInt residue) { return GetWheelTables().residueIndexList[residue]; }
+    // mask of the bits within a byte for the residues up to and including this one
+    static uint8_t GetResiduesUpToMask(BigInt residue) { return GetWheelTables().upToMaskList[residue]; }
+
+    template<typename Func>
+    void ForEachPrime(Func func) const
+    {
+        for (auto iter = m_segmentSmallPrimeList.begin(); iter != m_segmentSmallPrimeList.end(); ++iter)
+        {
+            func(*iter);
+        }
+
+        const WheelTables& tables = GetWheelTables();
+        const BigInt numWords = (BigInt)m_bytes.size() / 8;
+        for (BigInt w = 0; w < numWords; ++w)
+        {
+            uint64_t word;
+            memcpy(&word, &m_bytes[w * 8], sizeof(word));
+            while (word != 0)
+            {
+                const BigInt bitIndex = CalcLowestSetBit(word);
+                func(m_segmentLo + WHEEL_SIZE * (w * 8 + (bitIndex >> 3)) + tables.residueList[bitIndex & 7]);
+                word &= word - 1;
+            }
+        }
+    }
+
+    BigInt CountPrimes() const
+    {
+        BigInt count = (BigInt)m_segmentSmallPrimeList.size();
+        const BigInt numWords = (BigInt)m_bytes.size() / 8;
+        for (BigInt w = 0; w < numWords; ++w)
+        {
+            uint64_t word;
+            memcpy(&word, &m_bytes[w * 8], sizeof(word));
+            count += CalcPopCount(word);
+        }
+        return count;
+    }
+
+
+private:
+    struct WheelTables
+    {
+        BigInt residueList[NUM_WHEEL_RESIDUES];
+        BigInt wheelGapList[NUM_WHEEL_RESIDUES];     // distance from each residue to the next
+        BigInt residueIndexList[WHEEL_SIZE];         // bit index of a residue (-1 if the residue is not coprime to 30)
+        BigInt nextCoprimeGapList[WHEEL_SIZE];       // distance from any residue up to the next coprime one (0 if coprime)
+        uint8_t clearMaskList[WHEEL_SIZE];           // byte mask clearing the bit of a residue
+        uint8_t upToMaskList[WHEEL_SIZE];            // byte mask of the bits for all residues up to and including a residue
+
+        // for a prime of residue class c, at multiplier residue index i:  the bit mask to clear,
+        // and the part of the byte step to the next multiple beyond (p / 30) * gap
+        uint8_t stepClearMaskList[NUM_WHEEL_RESIDUES][NUM_WHEEL_RESIDUES];
+        BigInt stepCorrectionList[NUM_WHEEL_RESIDUES][NUM_WHEEL_RESIDUES];
+        uint8_t presievePattern[PRESIEVE_PATTERN_SIZE];
+
+        WheelTables()
+        {
+            static const BigInt s_residueList[NUM_WHEEL_RESIDUES] = { 1, 7, 11, 13, 17, 19, 23, 29 };
+            for (BigInt i = 0; i < NUM_WHEEL_RESIDUES; ++i)
+            {
+                residueList[i] = s_residueList[i];
+                wheelGapList[i] = (i + 1 < NUM_WHEEL_RESIDUES) ? (s_residueList[i + 1] - s_residueList[i]) : (WHEEL_SIZE + 1 - s_residueList[i]);
+            }
+
+            // the last residue is 29, so every residue 0 through 29 has a coprime residue at or above it
+            BigInt residueIndex = 0;
+            for (BigInt r = 0; r < WHEEL_SIZE; ++r)
+            {
+                while (s_residueList[residueIndex] < r)
+                {
+                    ++residueIndex;
+                }
+                const bool isCoprime = (s_residueList[residueIndex] == r);
+                nextCoprimeGapList[r] = s_residueList[residueIndex] - r;
+                residueIndexList[r] = isCoprime ? residueIndex : -1;
+                clearMaskList[r] = isCoprime ? (uint8_t)~(1 << residueIndex) : (uint8_t)0xff;
+                upToMaskList[r] = (uint8_t)((1 << (isCoprime ? residueIndex + 1 : residueIndex)) - 1);
+            }
+
+            for (BigInt c = 0; c < NUM_WHEEL_RESIDUES; ++c)
+            {
+                for (BigInt i = 0; i < NUM_WHEEL_RESIDUES; ++i)
+                {
+                    const BigInt multipleResidue = (s_residueList[c] * s_residueList[i]) % WHEEL_SIZE;
+                    stepClearMaskList[c][i] = clearMaskList[multipleResidue];
+                    stepCorrectionList[c][i] = (multipleResidue + s_residueList[c] * wheelGapList[i]) / WHEEL_SIZE;
+                }
+            }
+
+            for (BigInt b = 0; b < PRESIEVE_PATTERN_SIZE; ++b)
+            {
+                uint8_t bits = 0;
+                for (BigInt i = 0; i < NUM_WHEEL_RESIDUES; ++i)
+                {
+                    const BigInt num = WHEEL_SIZE * b + s_residueList[i];
+                    if ((num % 7 != 0) && (num % 11 != 0) && (num % 13 != 0))
+                    {
+                        bits |= (uint8_t)(1 << i);
+                    }
+                }
+                presievePattern[b] = bits;
+            }
+        }
+    };
+
+    static const WheelTables& GetWheelTables()
+    {
+        static const WheelTables s_tables;
+        return s_tables;
+    }
+
+    void ClearBitsOutsideRange()
+    {
+        const WheelTables& tables = GetWheelTables();
+        for (BigInt r = 0; (r < WHEEL_SIZE) && (m_segmentLo + r < m_lo); ++r)
+        {
+            m_bytes[0] &= tables.clearMaskList[r];
+        }
+
+        const BigInt lastByteLo = m_segmentLo + WHEEL_SIZE * (m_segmentNumBytes - 1);
+        for (BigInt r = std::max(m_hi - lastByteLo, 0LL); r < WHEEL_SIZE; ++r)
+        {
+            m_bytes[m_segmentNumBytes - 1] &= tables.clearMaskList[r];
+        }
+    }
+
+    BigInt m_segmentMaxBytes;
+    BigInt m_lo;
+    BigInt m_hi;
+    BigInt m_nextLo;
+    BigInt m_segmentLo;
+    BigInt m_segmentNumBytes;
+    std::vector<uint8_t> m_bytes;
+    std::vector<BigInt> m_segmentSmallPrimeList;
+    std::vector<BigInt> m_primeList;
+    std::vector<BigInt> m_nextByteList;
+    std::vector<BigInt> m_wheelIndexList;
+};
+
+////////////////////////////
+// Range factorization
+
+// Factorizes every number in [lo, hi), a block at a time, calling func(num, factorization) for each in order.
+// Each base prime p <= sqrt(hi) divides itself out of all its multiples in the block at once (carrying its next
+// multiple from block to block), and whatever is left of a number after that is a single prime.
+// There's no trial division or cache, so this works just as well on windows far from zero.
+template<typename Func>
+void FactorizeRange(BigInt lo, BigInt hi, Func func)
+{
+    static const BigInt s_blockSize = 8 * 1024;
+
+    lo = std::max(lo, 1LL);
+    if (hi <= lo)
+    {
+        return;
+    }
+
+    std::vector<BigInt> basePrimes;
+    FindBasePrimes(CalcSqrtFloor(hi - 1), basePrimes);
+    std::vector<BigInt> nextMultipleList;
+    nextMultipleList.reserve(basePrimes.size());
+    for (auto iter = basePrimes.begin(); iter != basePrimes.end(); ++iter)
+    {
+        nextMultipleList.push_back(((lo + *iter - 1) / *iter) * *iter);
+    }
+
+    std::vector<Factorization> factorizationList(s_blockSize);
+    std::vector<BigInt> remainingList(s_blockSize);
+    for (BigInt blockLo = lo; blockLo < hi; blockLo += s_blockSize)
+    {
+        const BigInt blockHi = std::min(blockLo + s_blockSize, hi);
+        const BigInt blockNumNums = blockHi - blockLo;
+        for (BigInt i = 0; i < blockNumNums; ++i)
+        {
+            factorizationList[i].clear();
+            remainingList[i] = blockLo + i;
+        }
+
+        const BigInt numBasePrimes = (BigInt)basePrimes.size();
+        for (BigInt p = 0; p < numBasePrimes; ++p)
+        {
+            const BigInt prime = basePrimes[p];
+            BigInt num = nextMultipleList[p];
+            for (; num < blockHi; num += prime)
+            {
+                BigInt& remaining = remainingList[num - blockLo];
+                BigInt numFactors = 0;
+                do
+                {
+                    remaining /= prime;
+                    ++numFactors;
+                } while (remaining % prime == 0);
+                factorizationList[num - blockLo].AddFactors(prime, numFactors);
+            }
+            nextMultipleList[p] = num;
+        }
+
+        for (BigInt i = 0; i < blockNumNums; ++i)
+        {
+            if (remainingList[i] > 1)
+            {
+                factorizationList[i].AddFactors(remainingList[i], 1);
+            }
+            func(blockLo + i, factorizationList[i]);
+        }
+    }
+}
+
+void TestFactorizationRange(BigInt max)
+{
+    FactorizeRange(2, max + 1, [](BigInt num, const Factorization& f) { PrintFactorization(num, f); });
+}
+
+// checks a window of range factorizations against the products and primality of their factors
+void TestFactorizeRangeWindow(BigInt lo, BigInt numNums)
+{
+    BigInt numMismatches = 0;
+    FactorizeRange(lo, lo + numNums, [&numMismatches](BigInt num, const Factorization& f) {
+        bool isGood = (f.CalcProduct() == num);
+        for (auto iter = f.begin(); iter != f.end(); ++iter)
+        {
+            isGood = isGood && IsNumberPrime(iter->prime);
+        }
+        numMismatches += isGood ? 0 : 1;
+    });
+
+    printf("Range factorization of [%lld, %lld) checked:  %lld mismatches\n", lo, lo + numNums, numMismatches);
+}
+
+////////////////////////////
+// Parallel segmented sieve
+
+BigInt CalcNumSieveThreads(BigInt requestedNumThreads)
+{
+    if (requestedNumThreads > 0)
+    {
+        return requestedNumThreads;
+    }
+
+    // 0 means use every hardware thread
+    return std::max((BigInt)std::thread::hardware_concurrency(), 1LL);
+}
+
+// Splits [lo, hi) into contiguous chunks of whole segments, which worker threads claim in order off a shared counter.
+// Every thread sieves its chunks with its own Sieve (OddSegmentSieve or WheelSegmentSieve) off the one shared base prime table,
+// and reports each sieved segment along with the index of the chunk it belongs to,
+// so callers can keep per-chunk results and merge them back in order (or just reduce them).
+template<typename Sieve>
+class ParallelSegmentSieve
+{
+public:
+    static const BigInt MIN_PARALLEL_RANGE = 1LL << 24;
+    static const BigInt MIN_CHUNK_NUM_SEGMENTS = 16;
+    static const BigInt CHUNKS_PER_THREAD = 8;
+
+    ParallelSegmentSieve(BigInt lo, BigInt hi, BigInt numThreads = 0) : m_lo(std::max(lo, 0LL)), m_hi(std::max(hi, lo))
+    {
+        m_numThreads = CalcNumSieveThreads(numThreads);
+        if ((m_hi - m_lo) < MIN_PARALLEL_RANGE)
+        {
+            m_numThreads = 1;
+        }
+
+        // keep chunk edges on segment edges, so no chunk wastes a partial segment
+        const BigInt segmentSpan = Sieve::SEGMENT_SPAN;
+        const BigInt desiredNumChunks = m_numThreads * CHUNKS_PER_THREAD;
+        BigInt chunkNumSegments = ((m_hi - m_lo) / desiredNumChunks + segmentSpan - 1) / segmentSpan;
+        chunkNumSegments = std::max(chunkNumSegments, (BigInt)MIN_CHUNK_NUM_SEGMENTS);
+        m_chunkSize = chunkNumSegments * segmentSpan;
+        m_numChunks = std::max((m_hi - m_lo + m_chunkSize - 1) / m_chunkSize, 1LL);
+
+        FindBasePrimes(CalcSqrtFloor(std::max(m_hi - 1, 0LL)), m_basePrimes);
+    }
+
+    BigInt GetNumThreads() const { return m_numThreads; }
+    BigInt GetNumChunks() const { return m_numChunks; }
+
+    // segmentFunc(chunkIndex, sieve) is called from the worker threads, once per sieved segment;
+    // segments of any one chunk are reported in order, on a single thread
+    template<typename SegmentFunc>
+    void Run(SegmentFunc segmentFunc) const
+    {
+        std::atomic<BigInt> nextChunkIndex(0);
+
+        auto worker = [&]() {
+            Sieve sieve;
+            for (;;)
+            {
+                const BigInt chunkIndex = nextChunkIndex++;
+                if (chunkIndex >= m_numChunks)
+                {
+                    break;
+                }
+
+                const BigInt chunkLo = m_lo + chunkIndex * m_chunkSize;
+                const BigInt chunkHi = std::min(chunkLo + m_chunkSize, m_hi);
+                sieve.Init(chunkLo, chunkHi, m_basePrimes);
+                while (sieve.SieveNextSegment())
+                {
+                    segmentFunc(chunkIndex, sieve);
+                }
+            }
+        };
+
+        std::vector<std::thread> threadList;
+        for (BigInt i = 1; i < m_numThreads; ++i)
+        {
+            threadList.emplace_back(worker);
+        }
+        worker();
+        for (auto iter = threadList.begin(); iter != threadList.end(); ++iter)
+        {
+            iter->join();
+        }
+    }
+
+
+private:
+    BigInt m_lo;
+    BigInt m_hi;
+    BigInt m_numThreads;
+    BigInt m_chunkSize;
+    BigInt m_numChunks;
+    std::vector<BigInt> m_basePrimes;
+};
+
+BigInt CountPrimesInRange(BigInt lo, BigInt hi, BigInt numThreads = 0)
+{
+    ParallelSegmentSieve<WheelSegmentSieve> parallelSieve(lo, hi, numThreads);
+
+    std::vector<BigInt> chunkCountList(parallelSieve.GetNumChunks(), 0);
+    parallelSieve.Run([&chunkCountList](BigInt chunkIndex, const WheelSegmentSieve& sieve) {
+        chunkCountList[chunkIndex] += sieve.CountPrimes();
+    });
+
+    return std::accumulate(chunkCountList.begin(), chunkCountList.end(), 0LL);
+}
+
+// (128 bits, since the sum passes 2^63 before 10^11)
+UInt128 SumPrimesInRange(BigInt lo, BigInt hi, BigInt numThreads = 0)
+{
+    ParallelSegmentSieve<WheelSegmentSieve> parallelSieve(lo, hi, numThreads);
+
+    std::vector<UInt128> chunkSumList(parallelSieve.GetNumChunks());
+    parallelSieve.Run([&chunkSumList](BigInt chunkIndex, const WheelSegmentSieve& sieve) {
+        UInt128 sum;
+        sieve.ForEachPrime([&sum](BigInt prime) { sum += (uint64_t)prime; });
+        chunkSumList[chunkIndex] += sum;
+    });
+
+    return std::accumulate(chunkSumList.begin(), chunkSumList.end(), UInt128());
+}
+
+BigInt CalcNthPrimeUpperBound(BigInt n)
+{
+    // Rosser's bound:  p(n) < n (ln n + ln ln n)  for n >= 6
+    if (n < 6)
+    {
+        return 13;
+    }
+
+    const double logN = log((double)n);
+    return (BigInt)((double)n * (logN + log(logN))) + 1;
+}
+
+////////////////////////////
+// Prime ranges
+//
+//      Streams the primes in [lo, hi) in increasing order, sieving one segment at a time as it goes,
+//      so it never holds more than one segment plus the base primes up to sqrt(hi)
+//
+
+class PrimeRange
+{
+public:
+    // single pass:  every iterator shares the range's sieve, so advancing one advances them all
+    class Iterator
+    {
+    public:
+        Iterator(PrimeRange* range = nullptr) : m_range(range) {}
+
+        BigInt operator*() const { return m_range->m_prime; }
+
+        Iterator& operator++()
+        {
+            if (!m_range->Advance())
+            {
+                m_range = nullptr;
+            }
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const { return (m_range == other.m_range); }
+        bool operator!=(const Iterator& other) const { return (m_range != other.m_range); }
+
+    private:
+        PrimeRange* m_range;
+    };
+
+    PrimeRange(BigInt lo, BigInt hi) : m_lo(std::max(lo, 0LL)), m_hi(std::max(hi, lo)), m_prime(0)
+    {
+        FindBasePrimes(CalcSqrtFloor(std::max(m_hi - 1, 0LL)), m_basePrimes);
+    }
+
+    // (re)starts the stream at lo
+    Iterator begin()
+    {
+        m_sieve.Init(m_lo, m_hi, m_basePrimes);
+        m_smallPrimeIndex = 0;
+        m_wordIndex = 0;
+        m_numWords = 0;
+        m_word = 0;
+
+        return Advance() ? Iterator(this) : Iterator();
+    }
+    Iterator end() { return Iterator(); }
+
+
+private:
+    bool Advance()
+    {
+        for (;;)
+        {
+            const std::vector<BigInt>& smallPrimeList = m_sieve.GetSegmentSmallPrimes();
+            if (m_smallPrimeIndex < (BigInt)smallPrimeList.size())
+            {
+                m_prime = smallPrimeList[m_smallPrimeIndex++];
+                return true;
+            }
+
+            if (m_word != 0)
+            {
+                const BigInt bitIndex = CalcLowestSetBit(m_word);
+                m_word &= m_word - 1;
+
+                const BigInt byteIndex = m_sieve.GetSegmentFirstByte() + 8 * m_wordIndex + (bitIndex >> 3);
+                m_prime = WheelSegmentSieve::WHEEL_SIZE * byteIndex + WheelSegmentSieve::GetBitResidue(bitIndex & 7);
+                return true;
+            }
+
+            if (m_wordIndex + 1 < m_numWords)
+            {
+                ++m_wordIndex;
+            }
+            else
+            {
+                if (!m_sieve.SieveNextSegment())
+                {
+                    return false;
+                }
+                m_smallPrimeIndex = 0;
+                m_wordIndex = 0;
+                m_numWords = m_sieve.GetSegmentNumWords();
+            }
+            memcpy(&m_word, m_sieve.GetSegmentBytes() + 8 * m_wordIndex, sizeof(m_word));
+        }
+    }
+
+    BigInt m_lo;
+    BigInt m_hi;
+    std::vector<BigInt> m_basePrimes;
+    WheelSegmentSieve m_sieve;
+
+    // position within the current segment
+    BigInt m_smallPrimeIndex;
+    BigInt m_wordIndex;
+    BigInt m_numWords;
+    uint64_t m_word;
+    BigInt m_prime;
+};
+
+// primes in [lo, hi), as a range for a range-based for loop
+PrimeRange Primes(BigInt lo, BigInt hi)
+{
+    return PrimeRange(lo, hi);
+}
+
+////////////////////////////
+// PrimeFinder
+
+enum SieveMode
+{
+    SIEVE_MODE_WINDOW,      // original window sieve, re-marking with every known prime
+    SIEVE_MODE_SEGMENTED,   // odd-only, bit-packed segmented sieve (OddSegmentSieve)
+    SIEVE_MODE_WHEEL,       // mod 30 wheel segmented sieve with 7/11/13 pre-sieve (WheelSegmentSieve)
+};
+
+class PrimeFinder : public std::vector<BigInt>
+{
+public:
+    PrimeFinder() : std::vector<BigInt>(), m_windowBase(3), m_windowOffset(0), m_sieveMode(SIEVE_MODE_WHEEL), m_numThreads(0)
+    {
+        // start the primes list with 2, and start the window base at the very next value, 3
+
+        push_back(2);
+    }
+
+    void Reset()
+    {
+        clear();
+        push_back(2);
+        m_windowBase = 3;
+        m_windowOffset = 0;
+    }
+
+    SieveMode GetSieveMode() const { return m_sieveMode; }
+    void SetSieveMode(SieveMode mode) { m_sieveMode = mode; }
+
+    // number of threads for large segmented sieves (0 = all hardware threads, 1 = single threaded)
+    BigInt GetNumThreads() const { return m_numThreads; }
+    void SetNumThreads(BigInt numThreads) { m_numThreads = numThreads; }
+
+    void FindPrimes(BigInt windowSize = 128)
+    {
+        if (windowSize <= 0)
+        {
+            return;
+        }
+
+        if (m_sieveMode == SIEVE_MODE_WINDOW)
+        {
+            FindPrimesInWindow(windowSize);
+        }
+        else if (m_sieveMode == SIEVE_MODE_SEGMENTED)
+        {
+            FindPrimesInSegments<OddSegmentSieve>(m_windowBase + windowSize);
+        }
+        else
+        {
+            FindPrimesInSegments<WheelSegmentSieve>(m_windowBase + windowSize);
+        }
+    }
+
+    BigInt FindNthPrime(BigInt n)
+    {
+        if (m_sieveMode != SIEVE_MODE_WINDOW)
+        {
+            // sieve straight up to a guaranteed upper bound instead of stepping window by window
+            const BigInt upperBound = CalcNthPrimeUpperBound(n);
+            if (((BigInt)size() < n) && (upperBound >= m_windowBase))
+            {
+                FindPrimes(upperBound + 1 - m_windowBase);
+            }
+        }
+
+        const BigInt windowSize = 2 * n;
+        while ((BigInt)size() < n)
+        {
+            FindPrimes(windowSize);
+            //PrintPrimes();
+        }
+        return (*this)[n - 1];
+    }
+
+    void FindPrimesBelow(BigInt max)
+    {
+        if (max <= 3)
+        {
+            Reset();
+            return;
+        }
+
+        if (max <= m_windowBase)
+        {
+            // already sieved past max, so just trim the list back
+            erase(std::lower_bound(begin(), end(), max), end());
+            m_windowBase = max;
+            return;
+        }
+
+        FindPrimes(max - m_windowBase);
+    }
+
+    void PrintPrimes()
+    {
+        for (auto iter = begin(); iter != end(); ++iter)
+        {
+            printf("%lld ", *iter);
+        }
+    }
+
+
+private:
+    void FindPrimesInWindow(BigInt windowSize)
+    {
+        // reinitialize window
+        std::fill(m_windowFlags.begin(), m_windowFlags.end(), true);
+        m_windowFlags.resize(windowSize, true);
+        assert(std::find(m_windowFlags.begin(), m_windowFlags.end(), false) == m_windowFlags.end());
+        m_windowOffset = 0;
+
+        // mark non-primes based on pre-existing primes
+        //printf("Marking non-primes based on previous non-primes\n");
+        for (auto iter = begin(); iter != end(); ++iter)
+        {
+            MarkNonPrimes(*iter);
+        }
+
+        // walk through window, adding new primes and marking more non-primes as we go
+        //printf("Walking through window to find more primes\n");
+        const BigInt maxPossiblePrime = m_windowBase + m_windowFlags.size();
+        for (BigInt currPossiblePrime = m_windowBase; currPossiblePrime < maxPossiblePrime; ++currPossiblePrime)
+        {
+            const bool isPrime = m_windowFlags[currPossiblePrime - m_windowBase];
+            m_windowOffset++;
+
+            if (isPrime)
+            {
+                //printf("%lld is prime!\n", currPossiblePrime);
+                push_back(currPossiblePrime);
+                MarkNonPrimes(currPossiblePrime);
+            }
+            //else {
+            //	printf("%lld is NOT prime!\n", currPossiblePrime);
+            //}
+        }
+
+        // move window for next time
+        m_windowBase += m_windowFlags.size();
+    }
+
+    template<typename Sieve>
+    void FindPrimesInSegments(BigInt max)
+    {
+        if ((CalcNumSieveThreads(m_numThreads) > 1) && ((max - m_windowBase) >= ParallelSegmentSieve<Sieve>::MIN_PARALLEL_RANGE))
+        {
+            FindPrimesInParallelSegments<Sieve>(max);
+            return;
+        }
+
+        Sieve sieve;
+
+        const BigInt sqrtMax = CalcSqrtFloor(max - 1);
+        if (m_windowBase > sqrtMax)
+        {
+            // the primes found so far already include all the base primes we need
+            sieve.Init(m_windowBase, max, *this);
+        }
+        else
+        {
+            std::vector<BigInt> basePrimes;
+            FindBasePrimes(sqrtMax, basePrimes);
+            sieve.Init(m_windowBase, max, basePrimes);
+        }
+
+        while (sieve.SieveNextSegment())
+        {
+            sieve.ForEachPrime([this](BigInt prime) { push_back(prime); });
+        }
+
+        m_windowBase = max;
+    }
+
+    template<typename Sieve>
+    void FindPrimesInParallelSegments(BigInt max)
+    {
+        ParallelSegmentSieve<Sieve> parallelSieve(m_windowBase, max, m_numThreads);
+
+        std::vector<std::vector<BigInt>> chunkPrimeLists(parallelSieve.GetNumChunks());
+        parallelSieve.Run([&chunkPrimeLists](BigInt chunkIndex, const Sieve& sieve) {
+            std::vector<BigInt>& primeList = chunkPrimeLists[chunkIndex];
+            sieve.ForEachPrime([&primeList](BigInt prime) { primeList.push_back(prime); });
+        });
+
+        // merge the chunks back in order
+        BigInt numNewPrimes = 0;
+        for (auto iter = chunkPrimeLists.begin(); iter != chunkPrimeLists.end(); ++iter)
+        {
+            numNewPrimes += (BigInt)iter->size();
+        }
+        reserve(size() + numNewPrimes);
+        for (auto iter = chunkPrimeLists.begin(); iter != chunkPrimeLists.end(); ++iter)
+        {
+            insert(end(), iter->begin(), iter->end());
+            std::vector<BigInt>().swap(*iter);
+        }
+
+        m_windowBase = max;
+    }
+
+    void MarkNonPrimes(BigInt num)
+    {
+        //printf("Marking non-primes:  num = %lld\n", num);
+        const BigInt firstNum = m_windowBase + m_windowOffset;
+        //printf("firstNum %lld = base %lld + offset %lld\n", firstNum, m_windowBase, m_windowOffset);
+
+        const auto devRem = lldiv(firstNum, num);
+        //printf("firstNum %lld / %lld =  %lld q, %lld r\n", firstNum, num, devRem.quot, devRem.rem);
+
+        BigInt firstQuot = devRem.quot;
+        if (devRem.rem > 0)
+        {
+            ++firstQuot;
+        }
+        //printf("firstQuot = %lld\n", firstQuot);
+
+        BigInt firstNonPrime = firstQuot * num;
         //printf("firstNonPrime = %lld\n", firstNonPrime);
         const BigInt maxNonPrime = m_windowBase + m_windowFlags.size();
 
-        for (BigInt currNonPrime = firstNonPrime; currNonPrime < maxNonPrime; currNonPrime += num)
+        for (BigInt currNonPrime = firstNonPrime; currNonPrime < maxNonPrime; currNonPrime += num)
+        {
+            //printf("Marking %lld as non-prime\n", currNonPrime);
+            m_windowFlags[currNonPrime - m_windowBase] = false;
+        }
+    }
+
+    BigInt m_windowBase;
+    BigInt m_windowOffset;
+    std::vector<bool> m_windowFlags;
+    SieveMode m_sieveMode;
+    BigInt m_numThreads;
+};
+
+static PrimeFinder s_primeFinder;
+
+void TestPrimeFinder(BigInt window)
+{
+    s_primeFinder.FindPrimes(window);
+    printf("Prime finder window of %lld resulted in these primes:  ", window);
+    s_primeFinder.PrintPrimes();
+    printf("\n\n");
+
+    s_primeFinder.FindPrimes(window);
+    printf("Prime finder window of %lld more resulted in these primes:  ", window);
+    s_primeFinder.PrintPrimes();
+    printf("\n\n");
+}
+
+void TestPrimeFinderSieveMode(SieveMode mode, BigInt max)
+{
+    PrimeFinder reference;
+    reference.SetSieveMode(SIEVE_MODE_WINDOW);
+    reference.FindPrimesBelow(max);
+
+    PrimeFinder finder;
+    finder.SetSieveMode(mode);
+    finder.FindPrimesBelow(max / 3);
+    finder.FindPrimesBelow(max);
+
+    const bool match = (static_cast<const std::vector<BigInt>&>(finder) == static_cast<const std::vector<BigInt>&>(reference));
+    printf(
+        "Sieve mode %d found %lld primes below %lld, window mode found %lld:  %s\n",
+        (int)mode,
+        (BigInt)finder.size(),
+        max,
+        (BigInt)reference.size(),
+        match ? "match" : "MISMATCH!");
+}
+
+
+////////////////////////////
+// PrimeCache
+
+// Primality flags for [0, limit) in the mod 30 wheel layout of WheelSegmentSieve (8 numbers per byte, 2/3/5 implied),
+// plus a running prime count at the start of every 64 byte block, so both lookups and prime counts
+// are a table read and at most 8 popcounts.
+// The flags and counts can be saved to a file and later mapped straight back in, read-only.
+class PrimeBitmap
+{
+public:
+    static const BigInt WORDS_PER_BLOCK = 8;
+    static const BigInt BLOCK_SPAN = WORDS_PER_BLOCK * 8 * WheelSegmentSieve::WHEEL_SIZE;
+    static const uint32_t FILE_FORMAT_VERSION = 2;
+
+    PrimeBitmap() : m_limit(0), m_numBlocks(0), m_wordData(nullptr), m_blockRankData(nullptr) {}
+
+    void Reset()
+    {
+        m_mappedFile.Close();
+        m_limit = 0;
+        m_numBlocks = 0;
+        std::vector<uint64_t>().swap(m_words);
+        std::vector<BigInt>().swap(m_blockRankList);
+        m_wordData = nullptr;
+        m_blockRankData = nullptr;
+    }
+
+    BigInt GetLimit() const { return m_limit; }
+    bool IsMapped() const { return m_mappedFile.IsOpen(); }
+
+    // sieve the flags out to at least the new limit (rounded up to a whole block)
+    void ExtendTo(BigInt limit, BigInt numThreads = 0)
+    {
+        limit = ((limit + BLOCK_SPAN - 1) / BLOCK_SPAN) * BLOCK_SPAN;
+        if (limit <= m_limit)
         {
-            //printf("Marking %lld as non-prime\n", currNonPrime);
-            m_windowFlags[currNonPrime - m_windowBase] = false;
+            return;
+        }
+
+        if (IsMapped())
+        {
+            // the mapping is read-only, so take a private copy before growing
+            m_words.assign(m_wordData, m_wordData + m_numBlocks * WORDS_PER_BLOCK);
+            m_blockRankList.assign(m_blockRankData, m_blockRankData + m_numBlocks);
+            m_mappedFile.Close();
+        }
+
+        const BigInt oldLimit = m_limit;
+        const BigInt oldNumBlocks = m_numBlocks;
+        const BigInt numBlocks = limit / BLOCK_SPAN;
+        m_words.resize(numBlocks * WORDS_PER_BLOCK, 0);
+        m_wordData = m_words.data();
+
+        // chunks start on whole blocks, so every thread writes to its own words
+        uint8_t* bytes = reinterpret_cast<uint8_t*>(m_words.data());
+        ParallelSegmentSieve<WheelSegmentSieve> parallelSieve(oldLimit, limit, numThreads);
+        parallelSieve.Run([bytes](BigInt, const WheelSegmentSieve& sieve) {
+            memcpy(bytes + sieve.GetSegmentFirstByte(), sieve.GetSegmentBytes(), sieve.GetSegmentNumBytes());
+        });
+
+        m_blockRankList.resize(numBlocks);
+        m_blockRankData = m_blockRankList.data();
+        BigInt rank = (oldNumBlocks > 0) ? (m_blockRankList[oldNumBlocks - 1] + CountBlock(oldNumBlocks - 1)) : 0;
+        for (BigInt block = oldNumBlocks; block < numBlocks; ++block)
+        {
+            m_blockRankList[block] = rank;
+            rank += CountBlock(block);
         }
+
+        m_numBlocks = numBlocks;
+        m_limit = limit;
     }
 
-    BigInt m_windowBase;
-    BigInt m_windowOffset;
-    std::vector<bool> m_windowFlags;
+    bool SaveToFile(const char* fileName) const
+    {
+        // written to the side and renamed into place, so runs that have the old file mapped never see it truncated
+        const std::string tempFileName = std::string(fileName) + ".tmp";
+        FILE* file = fopen(tempFileName.c_str(), "wb");
+        if (!file)
+        {
+            return false;
+        }
+
+        const FileHeader header = MakeFileHeader(m_limit);
+        bool ok = (fwrite(&header, sizeof(header), 1, file) == 1);
+        if (m_numBlocks > 0)
+        {
+            ok = ok && (fwrite(m_wordData, sizeof(uint64_t) * WORDS_PER_BLOCK, (size_t)m_numBlocks, file) == (size_t)m_numBlocks);
+            ok = ok && (fwrite(m_blockRankData, sizeof(BigInt), (size_t)m_numBlocks, file) == (size_t)m_numBlocks);
+        }
+        ok = (fclose(file) == 0) && ok;
+
+        if (ok && (rename(tempFileName.c_str(), fileName) != 0))
+        {
+            // (rename won't replace an existing file on Windows)
+            remove(fileName);
+            ok = (rename(tempFileName.c_str(), fileName) == 0);
+        }
+        if (!ok)
+        {
+            remove(tempFileName.c_str());
+        }
+
+        return ok;
+    }
+
+    // maps a saved bitmap in read-only (replacing the current flags);  fails if the file is missing or not in this exact format
+    bool MapFile(const char* fileName)
+    {
+        MappedFile mappedFile;
+        if (!mappedFile.Open(fileName) || (mappedFile.GetSize() < (BigInt)sizeof(FileHeader)))
+        {
+            return false;
+        }
+
+        // (the limit is always a whole number of blocks, or lookups near it would run off the end)
+        const FileHeader& header = *static_cast<const FileHeader*>(mappedFile.GetData());
+        const BigInt limit = (BigInt)header.limit;
+        if ((limit <= 0) || (limit % BLOCK_SPAN != 0))
+        {
+            return false;
+        }
+        const FileHeader expectedHeader = MakeFileHeader(limit);
+        if (memcmp(&header, &expectedHeader, sizeof(header)) != 0)
+        {
+            return false;
+        }
+        const BigInt numBlocks = limit / BLOCK_SPAN;
+        if (mappedFile.GetSize() != (BigInt)sizeof(FileHeader) + numBlocks * (BigInt)(sizeof(uint64_t) * WORDS_PER_BLOCK + sizeof(BigInt)))
+        {
+            return false;
+        }
+
+        const uint8_t* data = static_cast<const uint8_t*>(mappedFile.GetData());
+        const uint64_t* wordData = reinterpret_cast<const uint64_t*>(data + sizeof(FileHeader));
+        const BigInt* blockRankData = reinterpret_cast<const BigInt*>(wordData + numBlocks * WORDS_PER_BLOCK);
+
+        // the last block's count has to be what all the flags before it add up to
+        BigInt rank = 0;
+        for (const uint64_t* word = wordData; word < wordData + (numBlocks - 1) * WORDS_PER_BLOCK; ++word)
+        {
+            rank += CalcPopCount(*word);
+        }
+        if (blockRankData[numBlocks - 1] != rank)
+        {
+            return false;
+        }
+
+        Reset();
+        m_mappedFile.Swap(mappedFile);
+        m_wordData = wordData;
+        m_blockRankData = blockRankData;
+        m_numBlocks = numBlocks;
+        m_limit = limit;
+
+        return true;
+    }
+
+    bool IsPrime(BigInt num) const
+    {
+        assert(num < m_limit);
+        if (num < 7)
+        {
+            return (num == 2) || (num == 3) || (num == 5);
+        }
+
+        const lldiv_t div = lldiv(num, WheelSegmentSieve::WHEEL_SIZE);
+        const BigInt bitIndex = WheelSegmentSieve::GetResidueBitIndex(div.rem);
+        if (bitIndex < 0)
+        {
+            return false;
+        }
+
+        return (GetBytes()[div.quot] >> bitIndex) & 1;
+    }
+
+    // number of primes <= num
+    BigInt CalcPrimePi(BigInt num) const
+    {
+        assert(num < m_limit);
+        if (num < 7)
+        {
+            return (num >= 2) + (num >= 3) + (num >= 5);
+        }
+
+        const lldiv_t div = lldiv(num, WheelSegmentSieve::WHEEL_SIZE);
+        const BigInt byteIndex = div.quot;
+        const BigInt wordIndex = byteIndex / 8;
+        const BigInt block = wordIndex / WORDS_PER_BLOCK;
+
+        BigInt count = 3 + m_blockRankData[block];   // 2, 3 and 5 are not stored
+        for (BigInt w = block * WORDS_PER_BLOCK; w < wordIndex; ++w)
+        {
+            count += CalcPopCount(m_wordData[w]);
+        }
+
+        // the flags are laid out byte by byte, so count the bytes before this one in its word as bytes (not as the
+        // low bits of the word, which would only be right on little-endian machines)
+        const uint8_t* bytes = GetBytes();
+        for (BigInt b = wordIndex * 8; b < byteIndex; ++b)
+        {
+            count += CalcPopCount(bytes[b]);
+        }
+        count += CalcPopCount(bytes[byteIndex] & WheelSegmentSieve::GetResiduesUpToMask(div.rem));
+
+        return count;
+    }
+
+
+private:
+    // file layout:  this header, then the flag words, then the block counts
+    struct FileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t wheelSize;
+        uint64_t wordsPerBlock;
+        uint64_t limit;
+        uint64_t byteOrderMark;   // so a file from a machine of the other endianness doesn't match
+        uint64_t reserved[3];
+    };
+
+    static FileHeader MakeFileHeader(BigInt limit)
+    {
+        FileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "PRIMEBMP", sizeof(header.magic));
+        header.version = FILE_FORMAT_VERSION;
+        header.wheelSize = (uint32_t)WheelSegmentSieve::WHEEL_SIZE;
+        header.wordsPerBlock = (uint64_t)WORDS_PER_BLOCK;
+        header.limit = (uint64_t)limit;
+        header.byteOrderMark = 0x0102030405060708ULL;
+        return header;
+    }
+
+    const uint8_t* GetBytes() const { return reinterpret_cast<const uint8_t*>(m_wordData); }
+
+    BigInt CountBlock(BigInt block) const
+    {
+        BigInt count = 0;
+        for (BigInt w = block * WORDS_PER_BLOCK; w < (block + 1) * WORDS_PER_BLOCK; ++w)
+        {
+            count += CalcPopCount(m_wordData[w]);
+        }
+        return count;
+    }
+
+    BigInt m_limit;
+    BigInt m_numBlocks;
+    std::vector<uint64_t> m_words;
+    std::vector<BigInt> m_blockRankList;
+    MappedFile m_mappedFile;
+
+    // either the vectors above, or the mapped file
+    const uint64_t* m_wordData;
+    const BigInt* m_blockRankData;
 };
 
-static PrimeFinder s_primeFinder;
+class PrimeCache
+{
+public:
+    static const BigInt MIN_LIMIT = 1LL << 16;
 
-void TestPrimeFinder(BigInt window)
+    bool IsPrime(BigInt num)
+    {
+        if (num < 2)
+        {
+            return false;
+        }
+
+        Cover(num);
+        return m_bitmap.IsPrime(num);
+    }
+
+    // number of primes <= num
+    BigInt PrimePi(BigInt num)
+    {
+        if (num < 2)
+        {
+            return 0;
+        }
+
+        Cover(num);
+        return m_bitmap.CalcPrimePi(num);
+    }
+
+    BigInt GetLimit() const { return m_bitmap.GetLimit(); }
+    bool SaveToFile(const char* fileName) const { return m_bitmap.SaveToFile(fileName); }
+
+    // a mapped file is shared with every other run mapping it;  it's only copied if the cache has to grow past it
+    bool MapFile(const char* fileName) { return m_bitmap.MapFile(fileName); }
+
+
+private:
+    void Cover(BigInt num)
+    {
+        if (num >= m_bitmap.GetLimit())
+        {
+            // grow geometrically, so a scan creeping upwards does not re-sieve in small steps
+            m_bitmap.ExtendTo(std::max(std::max(num + 1, 2 * m_bitmap.GetLimit()), (BigInt)MIN_LIMIT));
+        }
+    }
+
+    PrimeBitmap m_bitmap;
+};
+
+static PrimeCache s_primeCache;
+
+void TestPrimeCache(BigInt max)
 {
-    s_primeFinder.FindPrimes(window);
-    printf("Prime finder window of %lld resulted in these primes:  ", window);
-    s_primeFinder.PrintPrimes();
-    printf("\n\n");
+    PrimeFinder finder;
+    finder.FindPrimesBelow(max);
+
+    PrimeCache cache;
+    BigInt numMismatches = 0;
+    auto primeIter = finder.begin();
+    for (BigInt num = -2; num < max; ++num)
+    {
+        while ((primeIter != finder.end()) && (*primeIter <= num))
+        {
+            ++primeIter;
+        }
+        const bool isPrime = (primeIter != finder.begin()) && (*(primeIter - 1) == num);
+        const BigInt primePi = (BigInt)(primeIter - finder.begin());
+        if ((cache.IsPrime(num) != isPrime) || (cache.PrimePi(num) != primePi))
+        {
+            ++numMismatches;
+        }
+    }
+
+    printf("Prime cache checked against %lld primes below %lld:  %lld mismatches\n", (BigInt)finder.size(), max, numMismatches);
+}
+
+void TestPrimeRange(BigInt lo, BigInt hi)
+{
+    PrimeFinder finder;
+    finder.FindPrimesBelow(hi);
+    auto primeIter = std::lower_bound(finder.begin(), finder.end(), lo);
+
+    BigInt numPrimes = 0;
+    BigInt numMismatches = 0;
+    for (BigInt prime : Primes(lo, hi))
+    {
+        if ((primeIter == finder.end()) || (*primeIter != prime))
+        {
+            ++numMismatches;
+        }
+        else
+        {
+            ++primeIter;
+        }
+        ++numPrimes;
+    }
+    numMismatches += (BigInt)(finder.end() - primeIter);
+
+    printf("Prime range [%lld, %lld) streamed %lld primes:  %lld mismatches\n", lo, hi, numPrimes, numMismatches);
+}
+
+// maps the bitmap file if it already covers the limit, otherwise sieves it and writes the file for next time
+void RunPrimeBitmapFile(const char* fileName, BigInt limit)
+{
+    PrimeCache cache;
+    if (cache.MapFile(fileName) && (cache.GetLimit() > limit))
+    {
+        printf("Mapped prime bitmap file '%s' (limit %lld)\n", fileName, cache.GetLimit());
+    }
+    else
+    {
+        cache.PrimePi(limit);
+        if (!cache.SaveToFile(fileName))
+        {
+            printf("Failed to write prime bitmap file '%s'\n", fileName);
+            return;
+        }
+        printf("Wrote prime bitmap file '%s' (limit %lld)\n", fileName, cache.GetLimit());
+    }
+
+    printf("pi(%lld) = %lld\n", limit, cache.PrimePi(limit));
+}
+
+////////////////////////////
+// Prime counting
+//
+//      Sublinear prime counting and summing (Lucy_Hedgehog's method), in O(x^(3/4)) time and O(sqrt(x)) memory
+//
+
+// S(v) starts out as the sum of f(n) over 2 <= n <= v, for every v of the form x / i.
+// Then for each prime p <= sqrt(x), in increasing order, S(v) -= f(p) * (S(v / p) - S(p - 1)) for every such v >= p^2,
+// which removes the numbers whose smallest prime factor is p.  After the last prime, S(x) is the sum of f over the primes.
+// (f must be completely multiplicative;  weightFunc(p, value) multiplies a value by f(p).)
+template<typename Value, typename PrefixFunc, typename WeightFunc>
+Value CalcLucyPrimeSum(BigInt x, PrefixFunc prefixFunc, WeightFunc weightFunc)
+{
+    if (x < 2)
+    {
+        return Value(0);
+    }
+
+    const BigInt root = CalcSqrtFloor(x);
+
+    // smallList[v] = S(v) for v <= root;  largeList[i] = S(x / i) for i <= root
+    std::vector<Value> smallList(root + 1);
+    std::vector<Value> largeList(root + 1);
+    for (BigInt v = 1; v <= root; ++v)
+    {
+        smallList[v] = prefixFunc(v);
+        largeList[v] = prefixFunc(x / v);
+    }
+
+    for (BigInt p = 2; p <= root; ++p)
+    {
+        if (smallList[p] == smallList[p - 1])
+        {
+            // p is not prime
+            continue;
+        }
+
+        const Value sumBelowP = smallList[p - 1];
+        const BigInt pSquared = p * p;
+
+        const BigInt largeMax = std::min(root, x / pSquared);
+        for (BigInt i = 1; i <= largeMax; ++i)
+        {
+            const BigInt d = i * p;
+            const Value& sumToQuot = (d <= root) ? largeList[d] : smallList[x / d];
+            largeList[i] -= weightFunc(p, sumToQuot - sumBelowP);
+        }
+
+        for (BigInt v = root; v >= pSquared; --v)
+        {
+            smallList[v] -= weightFunc(p, smallList[v / p] - sumBelowP);
+        }
+    }
+
+    return largeList[1];
+}
+
+// number of primes <= x
+BigInt CalcPrimeCount(BigInt x)
+{
+    return CalcLucyPrimeSum<BigInt>(
+        x, [](BigInt v) { return v - 1; }, [](BigInt, BigInt value) { return value; });
+}
+
+// sum of the primes <= x
+UInt128 CalcPrimeSum(BigInt x)
+{
+    return CalcLucyPrimeSum<UInt128>(
+        x,
+        [](BigInt v) { return ((v & 1) ? UInt128::CalcProduct(v, (v + 1) / 2) : UInt128::CalcProduct(v / 2, v + 1)) - UInt128(1); },
+        [](BigInt p, const UInt128& value) { return value * (uint64_t)p; });
+}
+
+// Estimates the nth prime, counts the primes up to the estimate, then sieves only the short stretch
+// between the estimate and the actual nth prime (forwards or backwards).
+BigInt CalcNthPrimeByCounting(BigInt n)
+{
+    static const BigInt INTERVAL_SIZE = 1LL << 20;
+
+    assert(n > 0);
+    if (n < 6)
+    {
+        static const BigInt s_firstPrimes[] = { 2, 3, 5, 7, 11 };
+        return s_firstPrimes[n - 1];
+    }
+
+    // Cipolla's asymptotic estimate, which lands within a fraction of a percent for large n
+    const double logN = log((double)n);
+    const double logLogN = log(logN);
+    const BigInt estimate = (BigInt)((double)n * (logN + logLogN - 1.0 + (logLogN - 2.0) / logN));
+
+    BigInt count = CalcPrimeCount(estimate);
+
+    std::vector<BigInt> basePrimes;
+    std::vector<BigInt> intervalPrimes;
+    auto sieveInterval = [&](BigInt lo, BigInt hi) {
+        FindBasePrimes(CalcSqrtFloor(hi - 1), basePrimes);
+        intervalPrimes.clear();
+        WheelSegmentSieve sieve;
+        sieve.Init(lo, hi, basePrimes);
+        while (sieve.SieveNextSegment())
+        {
+            sieve.ForEachPrime([&intervalPrimes](BigInt prime) { intervalPrimes.push_back(prime); });
+        }
+    };
+
+    if (count >= n)
+    {
+        // walk back down from the estimate;  the nth prime is the (count - n)th prime below it, counting from 0
+        BigInt hi = estimate + 1;
+        for (;;)
+        {
+            const BigInt lo = std::max(hi - INTERVAL_SIZE, 2LL);
+            sieveInterval(lo, hi);
+            const BigInt numPrimes = (BigInt)intervalPrimes.size();
+            if (count - n < numPrimes)
+            {
+                return intervalPrimes[numPrimes - 1 - (count - n)];
+            }
+            count -= numPrimes;
+            hi = lo;
+        }
+    }
+
+    // walk up from the estimate
+    BigInt lo = estimate + 1;
+    for (;;)
+    {
+        sieveInterval(lo, lo + INTERVAL_SIZE);
+        const BigInt numPrimes = (BigInt)intervalPrimes.size();
+        if (n - count <= numPrimes)
+        {
+            return intervalPrimes[n - count - 1];
+        }
+        count += numPrimes;
+        lo += INTERVAL_SIZE;
+    }
+}
+
+// checks the count and sum against the wheel sieve
+void TestPrimeCounting(BigInt x)
+{
+    const BigInt count = CalcPrimeCount(x);
+    const UInt128 sum = CalcPrimeSum(x);
+    const bool matches = (count == CountPrimesInRange(0, x + 1)) && (sum == SumPrimesInRange(0, x + 1));
+    printf("Primes <= %lld:  count = %lld, sum = %s, %s\n", x, count, sum.GetString().c_str(), matches ? "matches the sieve" : "MISMATCH");
+}
+
+// checks against sieving everything below the nth prime
+void TestNthPrimeByCounting(PrimeFinder& primeFinder, BigInt n)
+{
+    const BigInt nthPrime = CalcNthPrimeByCounting(n);
+    const BigInt sievedNthPrime = primeFinder.FindNthPrime(n);
+    printf(
+        "Prime #%lld by counting = %lld, by sieving = %lld, %s\n",
+        n,
+        nthPrime,
+        sievedNthPrime,
+        (nthPrime == sievedNthPrime) ? "match" : "MISMATCH");
+}
+
+void TestPrimeCountingSwitchOvers()
+{
+    // around where the prime sum (2^24) and nth prime (2^20) switch over to counting
+    const BigInt xList[] = { 1000, (1LL << 20) - 1, 1LL << 20, (1LL << 24) - 1, 1LL << 24, 100000007 };
+    for (BigInt x : xList)
+    {
+        TestPrimeCounting(x);
+    }
 
-    s_primeFinder.FindPrimes(window);
-    printf("Prime finder window of %lld more resulted in these primes:  ", window);
-    s_primeFinder.PrintPrimes();
-    printf("\n\n");
+    // (small n estimate low and walk up;  big n estimate high and walk back down)
+    PrimeFinder primeFinder;
+    const BigInt nList[] = { 6, 1000, 99999, (1LL << 20) - 1, 1LL << 20, 3000017, (1LL << 24) - 1, 1LL << 24 };
+    for (BigInt n : nList)
+    {
+        TestNthPrimeByCounting(primeFinder, n);
+    }
 }
 
 
 ////////////////////////////
-// PrimeCache
+// Number theoretic transform
 
-class PrimeCache
+inline uint32_t CalcPowerMod32(uint64_t base, uint64_t power, uint32_t mod)
 {
-public:
-    PrimeCache()
+    uint64_t result = 1;
+    base %= mod;
+    while (power > 0)
     {
-        for (auto iter = s_primeFinder.begin(); iter != s_primeFinder.end(); ++iter)
+        if (power & 1)
         {
-            m_set.insert(*iter);
+            result = result * base % mod;
         }
+        base = base * base % mod;
+        power >>= 1;
     }
+    return (uint32_t)result;
+}
 
-    bool IsPrime(BigInt num)
+// In place transform (or inverse transform) of a power of two sized list of residues mod PRIME, which must be c 2^k + 1
+// with 2^k at least the list size and PRIMITIVE_ROOT generating its whole multiplicative group.
+template<uint32_t PRIME, uint32_t PRIMITIVE_ROOT>
+void CalcNumberTheoreticTransform(std::vector<uint32_t>& valueList, bool inverse)
+{
+    const BigInt size = (BigInt)valueList.size();
+    assert((size & (size - 1)) == 0);
+    assert((PRIME - 1) % size == 0);
+
+    // bit reversal permutation, so the butterflies below can work in place
+    for (BigInt i = 1, j = 0; i < size; ++i)
     {
-        while (s_primeFinder.empty() || s_primeFinder.back() < num)
+        BigInt bit = size >> 1;
+        for (; j & bit; bit >>= 1)
         {
-            const BigInt origNumPrimes = (BigInt)s_primeFinder.size();
-            s_primeFinder.FindPrimes();
-            const BigInt newNumPrimes = (BigInt)s_primeFinder.size();
-            for (BigInt i = origNumPrimes; i < (BigInt)newNumPrimes; ++i)
-            {
-                m_set.insert(s_primeFinder[i]);
-            }
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j)
+        {
+            std::swap(valueList[i], valueList[j]);
         }
-
-        const bool isPrime = (m_set.count(num) > 0);
-        return isPrime;
     }
 
+    std::vector<uint32_t> twiddleList;
+    twiddleList.reserve(size / 2);
+    for (BigInt length = 2; length <= size; length <<= 1)
+    {
+        const BigInt halfLength = length / 2;
+        uint64_t rootOfUnity = CalcPowerMod32(PRIMITIVE_ROOT, (PRIME - 1) / length, PRIME);
+        if (inverse)
+        {
+            rootOfUnity = CalcPowerMod32(rootOfUnity, PRIME - 2, PRIME);
+        }
 
-private:
-    mutable std::unordered_set<BigInt> m_set;
-};
-
-static PrimeCache s_primeCache;
+        twiddleList.assign(1, 1);
+        for (BigInt i = 1; i < halfLength; ++i)
+        {
+            twiddleList.push_back((uint32_t)(twiddleList.back() * rootOfUnity % PRIME));
+        }
 
+        for (BigInt start = 0; start < size; start += length)
+        {
+            uint32_t* lowHalf = &valueList[start];
+            uint32_t* highHalf = lowHalf + halfLength;
+            for (BigInt i = 0; i < halfLength; ++i)
+            {
+                const uint32_t u = lowHalf[i];
+                const uint32_t v = (uint32_t)((uint64_t)highHalf[i] * twiddleList[i] % PRIME);
+                lowHalf[i] = (u + v >= PRIME) ? (u + v - PRIME) : (u + v);
+                highHalf[i] = (u >= v) ? (u - v) : (u + PRIME - v);
+            }
+        }
+    }
 
-////////////////////////////
-// Prime testing
-//
-//      Attempted fast computational testing without caching
-//
+    if (inverse)
+    {
+        const uint64_t sizeInverse = CalcPowerMod32(size, PRIME - 2, PRIME);
+        for (auto iter = valueList.begin(); iter != valueList.end(); ++iter)
+        {
+            *iter = (uint32_t)(*iter * sizeInverse % PRIME);
+        }
+    }
+}
 
-bool IsNumberPrime(BigInt num)
+// Cyclic convolution of a and b mod PRIME, padded out to size (which must cover numA + numB - 1 to not wrap around)
+template<uint32_t PRIME, uint32_t PRIMITIVE_ROOT>
+void CalcConvolutionMod(
+    const uint32_t* a,
+    BigInt numA,
+    const uint32_t* b,
+    BigInt numB,
+    BigInt size,
+    std::vector<uint32_t>& convolutionList)
 {
-    if (num <= 1)
-        return false;
-    if (num == 2)
-        return true;
-    if (!(num & 1))
-        return false;
+    // values are all below 10^9 (HugeInt limbs), and so below PRIME already
+    convolutionList.assign(a, a + numA);
+    convolutionList.resize(size, 0);
+    std::vector<uint32_t> otherList(b, b + numB);
+    otherList.resize(size, 0);
 
-    const BigInt sqrtNum = (BigInt)sqrt(num);
-    for (BigInt i = 3; i <= sqrtNum; i += 2)
+    CalcNumberTheoreticTransform<PRIME, PRIMITIVE_ROOT>(convolutionList, false);
+    CalcNumberTheoreticTransform<PRIME, PRIMITIVE_ROOT>(otherList, false);
+    for (BigInt i = 0; i < size; ++i)
     {
-        if (!(num % i))
-            return false;
+        convolutionList[i] = (uint32_t)((uint64_t)convolutionList[i] * otherList[i] % PRIME);
     }
-
-    return true;
+    CalcNumberTheoreticTransform<PRIME, PRIMITIVE_ROOT>(convolutionList, true);
 }
 
 
 ////////////////////////////
 // HugeInt
 
+// Non-negative integer of any size, stored as base 10^9 limbs from low to high (with no zero limbs on top,
+// so zero has none), which keeps decimal printing and digit sums cheap while the arithmetic works 9 digits at a time.
 class HugeInt
 {
 public:
-    HugeInt() : m_backwards(true) {}
-    HugeInt(BigInt num) : m_string(std::to_string(num)), m_backwards(false) {}
-    HugeInt(const char* st) : m_string(st), m_backwards(false) {}
-    HugeInt(std::string st) : m_string(st), m_backwards(false) {}
+    static const uint32_t LIMB_BASE = 1000000000;
+    static const BigInt LIMB_NUM_DIGITS = 9;
+    static const BigInt KARATSUBA_THRESHOLD = 40;           // in limbs, of the smaller side
+    static const BigInt NTT_THRESHOLD = 3000;               // in limbs, of the smaller side
+    static const BigInt NEWTON_DIVISION_THRESHOLD = 2500;   // in limbs, of both the denominator and the quotient
 
-    void Reset(bool backwards = true)
+    HugeInt() {}
+    HugeInt(BigInt num) { SetTo(num); }
+    HugeInt(const char* st) { SetTo(st); }
+    HugeInt(std::string st) { SetTo(st.c_str()); }
+
+    void Reset() { m_limbs.clear(); }
+
+    void SetTo(BigInt num)
     {
-        m_string.clear();
-        m_backwards = backwards;
+        assert(num >= 0);
+
+        m_limbs.clear();
+        while (num > 0)
+        {
+            const lldiv_t divRem = lldiv(num, LIMB_BASE);
+            m_limbs.push_back((uint32_t)divRem.rem);
+            num = divRem.quot;
+        }
     }
 
-    void SetTo(BigInt num)
+    void SetTo(const char* st)
     {
-        m_string = std::to_string(num);
-        m_backwards = false;
+        m_limbs.clear();
+
+        // 9 digit chunks, from the end of the string back
+        const BigInt numDigits = (BigInt)strlen(st);
+        for (BigInt chunkEnd = numDigits; chunkEnd > 0; chunkEnd -= LIMB_NUM_DIGITS)
+        {
+            uint32_t limb = 0;
+            for (BigInt i = std::max(chunkEnd - LIMB_NUM_DIGITS, 0LL); i < chunkEnd; ++i)
+            {
+                assert((st[i] >= '0') && (st[i] <= '9'));
+                limb = limb * 10 + (uint32_t)(st[i] - '0');
+            }
+            m_limbs.push_back(limb);
+        }
+        Trim();
     }
+
+    // this = this * 10 + digit
     void AppendDigit(BigInt digit)
     {
         assert(digit >= 0);
         assert(digit < 10);
-        m_string.push_back((char)(digit + '0'));
+        MultiplyAdd(10, (uint32_t)digit);
     }
 
     void Print() const { printf("%s", GetString()); }
+
+    // the decimal string is only built here, on the way out
     const char* GetString() const
     {
-        SetForwards();
+        m_string.clear();
+        if (m_limbs.empty())
+        {
+            m_string = "0";
+            return m_string.c_str();
+        }
+
+        char limbString[16];
+        sprintf(limbString, "%u", m_limbs.back());
+        m_string.reserve(m_limbs.size() * LIMB_NUM_DIGITS);
+        m_string = limbString;
+        for (auto iter = m_limbs.rbegin() + 1; iter != m_limbs.rend(); ++iter)
+        {
+            sprintf(limbString, "%09u", *iter);
+            m_string += limbString;
+        }
         return m_string.c_str();
     }
 
     void PrintDigits(BigInt numDigits) const
     {
-        SetForwards();
+        const char* st = GetString();
 
         const BigInt totalNumDigits = GetNumDigits();
         if (numDigits >= totalNumDigits)
         {
-            printf("%s", m_string.c_str());
+            printf("%s", st);
         }
         else
         {
-            printf("%s", m_string.substr(0, numDigits).c_str());
+            printf("%.*s", (int)numDigits, st);
         }
     }
 
-    BigInt GetNumDigits() const { return m_string.length(); }
+    BigInt GetNumDigits() const
+    {
+        if (m_limbs.empty())
+        {
+            return 1;
+        }
+
+        BigInt numTopDigits = 0;
+        for (uint32_t top = m_limbs.back(); top > 0; top /= 10)
+        {
+            ++numTopDigits;
+        }
+        return ((BigInt)m_limbs.size() - 1) * LIMB_NUM_DIGITS + numTopDigits;
+    }
 
     BigInt CalcSumDigits() const
     {
         BigInt sum = 0;
-        ConstIterator iter(*this);
-        while (!iter.IsAtEnd())
+        for (auto iter = m_limbs.begin(); iter != m_limbs.end(); ++iter)
         {
-            sum += iter.GetDigit();
-            iter.Increment();
+            for (uint32_t limb = *iter; limb > 0; limb /= 10)
+            {
+                sum += limb % 10;
+            }
         }
 
         return sum;
     }
 
+    HugeInt operator/(const HugeInt& other) const
+    {
+        HugeInt quot;
+        quot.SetToDivision(*this, other);
+        return quot;
+    }
+    HugeInt operator%(const HugeInt& other) const
+    {
+        HugeInt quot, rem;
+        quot.SetToDivision(*this, other, &rem);
+        return rem;
+    }
+
     HugeInt operator+(const HugeInt& other) const
     {
         const HugeInt* list[2] = { this, &other };
@@ -515,310 +3630,672 @@ public:
         CalcSum(list, 2);
     }
 
-    static HugeInt GetCalcedSum(const HugeInt* list, BigInt numItems) { return GetCalcedSum(ListIterator(list, numItems)); }
+    static HugeInt GetCalcedSum(const HugeInt* list, BigInt numItems)
+    {
+        HugeInt sum;
+        sum.CalcSum(list, numItems);
+        return sum;
+    }
     static HugeInt GetCalcedSum(const HugeInt* const* list, BigInt numItems)
     {
-        return GetCalcedSum(ListIterator(list, numItems));
+        HugeInt sum;
+        sum.CalcSum(list, numItems);
+        return sum;
+    }
+    void CalcSum(const HugeInt* list, BigInt numItems)
+    {
+        CalcSum(numItems, [list](BigInt i) -> const HugeInt& { return list[i]; });
     }
-    void CalcSum(const HugeInt* list, BigInt numItems) { CalcSum(ListIterator(list, numItems)); }
-    void CalcSum(const HugeInt* const* list, BigInt numItems) { CalcSum(ListIterator(list, numItems)); }
-
-    void Swap(HugeInt& other)
+    void CalcSum(const HugeInt* const* list, BigInt numItems)
     {
-        m_string.swap(other.m_string);
-        std::swap(m_backwards, other.m_backwards);
+        CalcSum(numItems, [list](BigInt i) -> const HugeInt& { return *list[i]; });
     }
 
+    void Swap(HugeInt& other) { m_limbs.swap(other.m_limbs); }
+
     void SetToProduct(const HugeInt& leftSide, BigInt rightSide)
     {
-        assert(rightSide > 0);   // zero is pointless
-
-        Reset();
+        assert(rightSide >= 0);
 
-        BigInt carryOver = 0;
-        for (ConstIterator iter(leftSide); !iter.IsAtEnd(); iter.Increment())
+        if ((uint64_t)rightSide >= LIMB_BASE)
         {
-            const BigInt digit = iter.GetDigit();
-            const BigInt num = digit * rightSide + carryOver;
-
-            const lldiv_t divRem = lldiv(num, 10);
-            const char outputDigit = (char)(divRem.rem + '0');
-            m_string.push_back(outputDigit);
-
-            carryOver = divRem.quot;
+            // too big to multiply a limb by in 64 bits
+            SetToProduct(leftSide, HugeInt(rightSide));
+            return;
         }
 
-        while (carryOver > 0)
+        if (&leftSide != this)
         {
-            const lldiv_t divRem = lldiv(carryOver, 10);
-            const char outputDigit = (char)(divRem.rem + '0');
-            m_string.push_back(outputDigit);
+            m_limbs = leftSide.m_limbs;
+        }
+        MultiplyAdd((uint32_t)rightSide, 0);
+    }
 
-            carryOver = divRem.quot;
+    // schoolbook multiplication for small numbers, Karatsuba above KARATSUBA_THRESHOLD limbs
+    void SetToProduct(const HugeInt& leftSide, const HugeInt& rightSide)
+    {
+        const std::vector<uint32_t>& leftLimbs = leftSide.m_limbs;
+        const std::vector<uint32_t>& rightLimbs = rightSide.m_limbs;
+        if (leftLimbs.empty() || rightLimbs.empty())
+        {
+            Reset();
+            return;
         }
+
+        std::vector<uint32_t> productLimbs(leftLimbs.size() + rightLimbs.size());
+        MultiplyLimbs(leftLimbs.data(), (BigInt)leftLimbs.size(), rightLimbs.data(), (BigInt)rightLimbs.size(), productLimbs.data());
+
+        m_limbs.swap(productLimbs);
+        Trim();
     }
 
     void SetToDivision(const HugeInt& numer, BigInt denom, BigInt* remainder = nullptr)
     {
         assert(denom > 0);   // zero is pointless
 
-        //printf("%s / %lld:\n", numer.GetString(), denom);
+        if (&numer != this)
+        {
+            m_limbs = numer.m_limbs;
+        }
+
+        // long division from the top limb down, one limb of quotient per step
+        uint64_t rem = 0;
+        const uint64_t udenom = (uint64_t)denom;
+        for (auto iter = m_limbs.rbegin(); iter != m_limbs.rend(); ++iter)
+        {
+            uint64_t quot;
+            if (udenom <= UINT32_MAX)
+            {
+                const uint64_t numerTemp = rem * LIMB_BASE + *iter;
+                quot = numerTemp / udenom;
+                rem = numerTemp % udenom;
+            }
+            else
+            {
+                // rem * 10^9 + limb can pass 64 bits, but rem < denom keeps the quotient under 10^9
+                const uint64_t low = rem * LIMB_BASE + *iter;
+                const uint64_t high = CalcMulHigh64(rem, LIMB_BASE) + ((low < rem * LIMB_BASE) ? 1 : 0);
+                quot = CalcDiv128(high, low, udenom, &rem);
+            }
+            *iter = (uint32_t)quot;
+        }
+        Trim();
+
+        if (remainder != nullptr)
+        {
+            *remainder = (BigInt)rem;
+        }
+    }
 
-        Reset(false);
+    // schoolbook long division for small numbers, multiplying by a Newton's method reciprocal for big ones
+    void SetToDivision(const HugeInt& numer, const HugeInt& denom, HugeInt* remainder = nullptr)
+    {
+        assert(!denom.m_limbs.empty());   // zero is pointless
 
-        ConstIterator iter(numer, false);
+        HugeInt quot, rem;
+        const BigInt numDenomLimbs = (BigInt)denom.m_limbs.size();
+        const BigInt numQuotLimbs = (BigInt)numer.m_limbs.size() - numDenomLimbs + 1;
+        if (Compare(numer, denom) < 0)
+        {
+            rem = numer;
+        }
+        else if (numDenomLimbs == 1)
+        {
+            BigInt limbRem = 0;
+            quot.SetToDivision(numer, (BigInt)denom.m_limbs[0], &limbRem);
+            rem.SetTo(limbRem);
+        }
+        else if ((numDenomLimbs >= NEWTON_DIVISION_THRESHOLD) && (numQuotLimbs >= NEWTON_DIVISION_THRESHOLD))
+        {
+            DivideNewton(numer, denom, quot, rem);
+        }
+        else
+        {
+            DivideSchoolbook(numer, denom, quot, rem);
+        }
 
-        BigInt numerTemp = 0;
-        while ((numerTemp < denom) && !iter.IsAtEnd())
+        Swap(quot);
+        if (remainder != nullptr)
         {
-            numerTemp *= 10;
-            numerTemp += iter.GetDigit();
-            iter.Increment();
+            remainder->Swap(rem);
         }
+    }
 
-        //printf("  numerTemp = %lld\n", numerTemp);
+    void SetToPower(BigInt base, BigInt power) { SetToPowerOf(base, power); }
+    void SetToPower(const HugeInt& base, BigInt power) { SetToPowerOf(base, power); }
 
-        if ((numerTemp < denom) && iter.IsAtEnd())
+    // < 0, 0, or > 0 as left is less than, equal to, or greater than right
+    static int Compare(const HugeInt& left, const HugeInt& right)
+    {
+        if (left.m_limbs.size() != right.m_limbs.size())
+        {
+            return (left.m_limbs.size() < right.m_limbs.size()) ? -1 : 1;
+        }
+
+        for (size_t i = left.m_limbs.size(); i > 0; --i)
         {
-            SetTo(0);
-            if (remainder != nullptr)
+            if (left.m_limbs[i - 1] != right.m_limbs[i - 1])
             {
-                *remainder = numerTemp;
+                return (left.m_limbs[i - 1] < right.m_limbs[i - 1]) ? -1 : 1;
             }
+        }
+        return 0;
+    }
+
+    class Sorter
+    {
+    public:
+        bool operator()(const HugeInt& left, const HugeInt& right) const { return (Compare(left, right) < 0); }
+    };
+
+
+private:
+    // drop zero limbs off the top
+    void Trim()
+    {
+        while (!m_limbs.empty() && (m_limbs.back() == 0))
+        {
+            m_limbs.pop_back();
+        }
+    }
+
+    // this = this * multiplier + addend, for multiplier and addend under the limb base
+    void MultiplyAdd(uint32_t multiplier, uint32_t addend)
+    {
+        uint64_t carryOver = addend;
+        for (auto iter = m_limbs.begin(); iter != m_limbs.end(); ++iter)
+        {
+            const uint64_t num = (uint64_t)*iter * multiplier + carryOver;
+            *iter = (uint32_t)(num % LIMB_BASE);
+            carryOver = num / LIMB_BASE;
+        }
+        if (carryOver > 0)
+        {
+            m_limbs.push_back((uint32_t)carryOver);
+        }
+        Trim();
+    }
+
+    // this *= LIMB_BASE^numLimbs, or /= LIMB_BASE^-numLimbs (rounding down) for negative numLimbs
+    void ShiftLimbs(BigInt numLimbs)
+    {
+        if (m_limbs.empty())
+        {
             return;
         }
 
-        for (;;)
+        if (numLimbs >= 0)
+        {
+            m_limbs.insert(m_limbs.begin(), numLimbs, 0);
+        }
+        else
         {
-            const lldiv_t div = lldiv(numerTemp, denom);
-            assert(div.quot >= 0);
-            assert(div.quot < 10);
+            m_limbs.erase(m_limbs.begin(), m_limbs.begin() + std::min(-numLimbs, (BigInt)m_limbs.size()));
+        }
+    }
+
+    void AddIn(const HugeInt& other)
+    {
+        m_limbs.resize(std::max(m_limbs.size(), other.m_limbs.size()) + 1, 0);
+        AddLimbs(m_limbs.data(), (BigInt)m_limbs.size(), other.m_limbs.data(), (BigInt)other.m_limbs.size());
+        Trim();
+    }
+
+    // other must be no bigger than this
+    void SubtractOut(const HugeInt& other)
+    {
+        assert(Compare(*this, other) >= 0);
+        SubtractLimbs(m_limbs.data(), (BigInt)m_limbs.size(), other.m_limbs.data(), (BigInt)other.m_limbs.size());
+        Trim();
+    }
+
+    // Knuth's algorithm D, for numer >= denom and denom with at least two limbs
+    static void DivideSchoolbook(const HugeInt& numer, const HugeInt& denom, HugeInt& quot, HugeInt& rem)
+    {
+        // scale both so the top denominator limb is at least half the base, which keeps each quotient limb guess within 2
+        const uint32_t scale = LIMB_BASE / (denom.m_limbs.back() + 1);
+        HugeInt scaledNumer(numer), scaledDenom(denom);
+        scaledNumer.MultiplyAdd(scale, 0);
+        scaledDenom.MultiplyAdd(scale, 0);
 
-            m_string.push_back('0' + (char)div.quot);
+        std::vector<uint32_t>& u = scaledNumer.m_limbs;
+        const std::vector<uint32_t>& v = scaledDenom.m_limbs;
+        const BigInt n = (BigInt)v.size();
+        const BigInt numQuotLimbs = (BigInt)numer.m_limbs.size() - n + 1;
+        u.resize(numer.m_limbs.size() + 1, 0);
+        quot.m_limbs.assign(numQuotLimbs, 0);
 
-            if (iter.IsAtEnd())
+        const uint64_t vTop = v[n - 1];
+        const uint64_t vNext = v[n - 2];
+        for (BigInt j = numQuotLimbs - 1; j >= 0; --j)
+        {
+            // guess the quotient limb from the top two limbs, then the next one
+            const uint64_t uTop = (uint64_t)u[j + n] * LIMB_BASE + u[j + n - 1];
+            uint64_t quotLimb = uTop / vTop;
+            uint64_t remLimb = uTop % vTop;
+            while ((quotLimb >= LIMB_BASE) || (quotLimb * vNext > remLimb * LIMB_BASE + u[j + n - 2]))
             {
-                if (remainder != nullptr)
+                --quotLimb;
+                remLimb += vTop;
+                if (remLimb >= LIMB_BASE)
                 {
-                    *remainder = div.rem;
+                    break;
                 }
-                return;
             }
 
-            numerTemp = div.rem * 10 + iter.GetDigit();
-            iter.Increment();
+            // u[j, j + n] -= quotLimb * v
+            uint64_t carryOver = 0;
+            int64_t borrow = 0;
+            for (BigInt i = 0; i < n; ++i)
+            {
+                const uint64_t product = quotLimb * v[i] + carryOver;
+                carryOver = product / LIMB_BASE;
+                const int64_t diff = (int64_t)u[i + j] - (int64_t)(product % LIMB_BASE) + borrow;
+                borrow = (diff < 0) ? -1 : 0;
+                u[i + j] = (uint32_t)(diff - borrow * LIMB_BASE);
+            }
+            const int64_t topDiff = (int64_t)u[j + n] - (int64_t)carryOver + borrow;
+            if (topDiff < 0)
+            {
+                // the guess was one too big (rarely), so add v back in, which carries the top back up to zero
+                --quotLimb;
+                u[j + n] = (uint32_t)(topDiff + AddLimbs(&u[j], n, v.data(), n));
+                assert(u[j + n] == 0);
+            }
+            else
+            {
+                u[j + n] = (uint32_t)topDiff;
+            }
+
+            quot.m_limbs[j] = (uint32_t)quotLimb;
         }
+        quot.Trim();
+
+        scaledNumer.Trim();
+        BigInt scaleRem = 0;
+        rem.SetToDivision(scaledNumer, (BigInt)scale, &scaleRem);
+        assert(scaleRem == 0);
     }
 
-    void SetToPower(BigInt base, BigInt power)
+    // recip = floor(LIMB_BASE^2n / denom) for an n limb denom:  the reciprocal of the top half of denom (a bit over, for
+    // the precision), scaled up, is good to about half the limbs, one Newton step x += x (B^2n - denom x) / B^2n doubles that,
+    // and a few single steps fix up the last units.
+    static void CalcReciprocal(const HugeInt& denom, HugeInt& recip)
     {
-        SetTo(base);
+        const BigInt n = (BigInt)denom.m_limbs.size();
+        HugeInt scaledOne(1);
+        scaledOne.ShiftLimbs(2 * n);
+
+        if (n < NEWTON_DIVISION_THRESHOLD)
+        {
+            HugeInt rem;
+            recip.SetToDivision(scaledOne, denom, &rem);
+            return;
+        }
 
-        HugeInt other;
+        const BigInt numTopLimbs = n / 2 + 2;
+        HugeInt top(denom);
+        top.ShiftLimbs(numTopLimbs - n);
+        CalcReciprocal(top, recip);
+        recip.ShiftLimbs(n - numTopLimbs);
+
+        HugeInt product, correction;
+        product.SetToProduct(denom, recip);
+        if (Compare(product, scaledOne) <= 0)
+        {
+            product.Swap(correction);
+            product = scaledOne;
+            product.SubtractOut(correction);
+            correction.SetToProduct(recip, product);
+            correction.ShiftLimbs(-2 * n);
+            recip.AddIn(correction);
+        }
+        else
+        {
+            product.SubtractOut(scaledOne);
+            correction.SetToProduct(recip, product);
+            correction.ShiftLimbs(-2 * n);
+            recip.SubtractOut(correction);
+        }
 
-        const BigInt numProd = power - 1;
-        for (BigInt i = 0; i < numProd; ++i)
+        product.SetToProduct(denom, recip);
+        while (Compare(product, scaledOne) > 0)
         {
-            Swap(other);
-            SetToProduct(other, base);
+            recip.SubtractOut(HugeInt(1));
+            product.SubtractOut(denom);
+        }
+        scaledOne.SubtractOut(product);
+        while (Compare(scaledOne, denom) >= 0)
+        {
+            recip.AddIn(HugeInt(1));
+            scaledOne.SubtractOut(denom);
         }
     }
 
-    class Sorter
+    static void DivideNewton(const HugeInt& numer, const HugeInt& denom, HugeInt& quot, HugeInt& rem)
     {
-    public:
-        bool operator()(const HugeInt& left, const HugeInt& right) const
+        // pad the denominator out with s zero limbs (at least half the numerator's size), so that
+        // x = floor(B^2(n + s) / (denom B^s)) gives quot within one as floor(numer x / B^(2n + s))
+        const BigInt n = (BigInt)denom.m_limbs.size();
+        const BigInt s = std::max((BigInt)0, (BigInt)numer.m_limbs.size() - 2 * n);
+        HugeInt paddedDenom(denom), recip;
+        paddedDenom.ShiftLimbs(s);
+        CalcReciprocal(paddedDenom, recip);
+
+        quot.SetToProduct(numer, recip);
+        quot.ShiftLimbs(-(2 * n + s));
+
+        HugeInt product;
+        product.SetToProduct(quot, denom);
+        rem = numer;
+        rem.SubtractOut(product);
+        while (Compare(rem, denom) >= 0)
         {
-            left.SetForwards();
-            right.SetForwards();
+            quot.AddIn(HugeInt(1));
+            rem.SubtractOut(denom);
+        }
+    }
 
-            if (left.m_string.length() < right.m_string.length())
-            {
-                return true;
-            }
+    // binary exponentiation, squaring down from the top bit of the power (base can be a BigInt or a HugeInt, even this one)
+    template<typename Base>
+    void SetToPowerOf(const Base& base, BigInt power)
+    {
+        assert(power >= 0);
+        if (power == 0)
+        {
+            SetTo(1);
+            return;
+        }
 
-            if (left.m_string.length() > right.m_string.length())
+        HugeInt result(base);
+        BigInt bit = 1;
+        while (bit <= power / 2)
+        {
+            bit <<= 1;
+        }
+        for (bit >>= 1; bit > 0; bit >>= 1)
+        {
+            result.SetToProduct(result, result);
+            if (power & bit)
             {
-                return false;
+                result.SetToProduct(result, base);
             }
-
-            return left.m_string < right.m_string;
         }
-    };
 
+        Swap(result);
+    }
 
-private:
-    void SetForwards() const
+    // dst[0, numDst) += src[0, numSrc), with numSrc <= numDst;  returns the carry out of the top
+    static uint32_t AddLimbs(uint32_t* dst, BigInt numDst, const uint32_t* src, BigInt numSrc)
     {
-        if (m_backwards)
+        uint32_t carryOver = 0;
+        BigInt i = 0;
+        for (; i < numSrc; ++i)
         {
-            Flip();
+            const uint32_t sum = dst[i] + src[i] + carryOver;
+            carryOver = (sum >= LIMB_BASE) ? 1 : 0;
+            dst[i] = sum - carryOver * LIMB_BASE;
         }
-    }
-    void SetBackwards() const
-    {
-        if (!m_backwards)
+        for (; (i < numDst) && (carryOver > 0); ++i)
         {
-            Flip();
+            const uint32_t sum = dst[i] + carryOver;
+            carryOver = (sum >= LIMB_BASE) ? 1 : 0;
+            dst[i] = sum - carryOver * LIMB_BASE;
         }
+        return carryOver;
     }
 
-    void Flip() const
+    // dst[0, numDst) -= src[0, numSrc), which must not go negative
+    static void SubtractLimbs(uint32_t* dst, BigInt numDst, const uint32_t* src, BigInt numSrc)
     {
-        std::reverse(m_string.begin(), m_string.end());
-        m_backwards = !m_backwards;
+        uint32_t borrow = 0;
+        BigInt i = 0;
+        for (; i < numSrc; ++i)
+        {
+            const uint32_t subtrahend = src[i] + borrow;
+            borrow = (dst[i] < subtrahend) ? 1 : 0;
+            dst[i] = dst[i] + borrow * LIMB_BASE - subtrahend;
+        }
+        for (; (i < numDst) && (borrow > 0); ++i)
+        {
+            borrow = (dst[i] == 0) ? 1 : 0;
+            dst[i] = dst[i] + borrow * LIMB_BASE - 1;
+        }
+        assert(borrow == 0);
     }
 
-    class ConstIterator
+    // result[0, numA + numB) = a * b, with result not overlapping either side
+    static void MultiplyLimbs(const uint32_t* a, BigInt numA, const uint32_t* b, BigInt numB, uint32_t* result)
     {
-    public:
-        ConstIterator(const HugeInt& parent, bool lowToHigh = true) : m_string(parent.m_string)
+        if (numA < numB)
         {
-            if (parent.m_backwards == lowToHigh)
-            {
-                // the digits are already in the direction we want them, so just interate from start to finish
-                m_index = 0;
-                m_endIndex = m_string.length();
-                m_increment = +1;
-            }
-            else
-            {
-                // the digits are in the opposite direction we want to iterate them in, so we must iterate backwards from the end
-                m_index = m_string.length() - 1;
-                m_endIndex = -1;
-                m_increment = -1;
-            }
+            std::swap(a, b);
+            std::swap(numA, numB);
         }
 
-        bool IsAtEnd() const { return (m_index == m_endIndex); }
-        void Increment()
+        if (numB < KARATSUBA_THRESHOLD)
         {
-            if (!IsAtEnd())
-            {
-                m_index += m_increment;
-            }
+            MultiplyLimbsSchoolbook(a, numA, b, numB, result);
+            return;
+        }
+        if (numB >= NTT_THRESHOLD)
+        {
+            MultiplyLimbsNtt(a, numA, b, numB, result);
+            return;
         }
 
-        BigInt GetDigit() const
+        if (2 * numB <= numA)
         {
-            if (IsAtEnd())
+            // lopsided:  multiply b by one b sized slice of a at a time, adding each in at its place
+            std::fill(result, result + numA + numB, 0);
+            std::vector<uint32_t> sliceProduct(2 * numB);
+            for (BigInt offset = 0; offset < numA; offset += numB)
             {
-                return 0;
+                const BigInt sliceSize = std::min(numB, numA - offset);
+                MultiplyLimbs(a + offset, sliceSize, b, numB, sliceProduct.data());
+                AddLimbs(result + offset, numA + numB - offset, sliceProduct.data(), sliceSize + numB);
             }
-            return (BigInt)m_string[m_index] - (BigInt)'0';
+            return;
         }
 
+        // Karatsuba:  with a = a1 B^m + a0 and b = b1 B^m + b0,
+        // a b = a1 b1 B^2m + ((a0 + a1)(b0 + b1) - a0 b0 - a1 b1) B^m + a0 b0, which is three half size multiplies instead of four
+        const BigInt m = numA / 2;
+        const BigInt numA1 = numA - m;
+        const BigInt numB1 = numB - m;
+        MultiplyLimbs(a, m, b, m, result);
+        MultiplyLimbs(a + m, numA1, b + m, numB1, result + 2 * m);
+
+        std::vector<uint32_t> aSum(a + m, a + numA);
+        aSum.push_back(AddLimbs(aSum.data(), numA1, a, m));
+        std::vector<uint32_t> bSum(b, b + m);
+        bSum.resize(std::max(m, numB1) + 1, 0);
+        AddLimbs(bSum.data(), (BigInt)bSum.size(), b + m, numB1);
+
+        std::vector<uint32_t> middle(aSum.size() + bSum.size());
+        MultiplyLimbs(aSum.data(), (BigInt)aSum.size(), bSum.data(), (BigInt)bSum.size(), middle.data());
+        SubtractLimbs(middle.data(), (BigInt)middle.size(), result, 2 * m);
+        SubtractLimbs(middle.data(), (BigInt)middle.size(), result + 2 * m, numA1 + numB1);
+
+        // the middle term is a0 b1 + a1 b0, which fits below the top of the result (the rest of its limbs are zero)
+        BigInt numMiddle = (BigInt)middle.size();
+        while ((numMiddle > numA + numB - m) && (middle[numMiddle - 1] == 0))
+        {
+            --numMiddle;
+        }
+        AddLimbs(result + m, numA + numB - m, middle.data(), numMiddle);
+    }
 
-    private:
-        const std::string& m_string;
-        BigInt m_index;
-        BigInt m_endIndex;
-        BigInt m_increment;
-    };
+    // NTT primes, each above 10^9 and c 2^k + 1 for k >= 25, with primitive roots
+    static const uint32_t NTT_PRIME_1 = 2013265921;   // 15 * 2^27 + 1
+    static const uint32_t NTT_PRIME_2 = 1811939329;   // 27 * 2^26 + 1
+    static const uint32_t NTT_PRIME_3 = 2113929217;   // 63 * 2^25 + 1
+    static const uint32_t NTT_ROOT_1 = 31;
+    static const uint32_t NTT_ROOT_2 = 13;
+    static const uint32_t NTT_ROOT_3 = 5;
 
-    class ListIterator
+    // Convolves the limbs mod three primes and puts each column back together with the CRT (Garner's method).
+    // The columns are under numB * 10^18, so this is exact as long as that stays under the ~7.7 * 10^27 product of the primes.
+    static void MultiplyLimbsNtt(const uint32_t* a, BigInt numA, const uint32_t* b, BigInt numB, uint32_t* result)
     {
-    public:
-        ListIterator(const HugeInt* itemList, BigInt numItems) : m_ptr(itemList), m_ptrptr(nullptr), m_num(numItems) {}
-        ListIterator(const HugeInt* const* itemList, BigInt numItems) : m_ptr(nullptr), m_ptrptr(itemList), m_num(numItems) {}
+        const BigInt numResult = numA + numB;
+        BigInt size = 1;
+        while (size < numResult - 1)
+        {
+            size <<= 1;
+        }
+        assert(size <= (1LL << 25));
 
-        BigInt GetNum() const { return m_num; }
+        std::vector<uint32_t> convolution1, convolution2, convolution3;
+        CalcConvolutionMod<NTT_PRIME_1, NTT_ROOT_1>(a, numA, b, numB, size, convolution1);
+        CalcConvolutionMod<NTT_PRIME_2, NTT_ROOT_2>(a, numA, b, numB, size, convolution2);
+        CalcConvolutionMod<NTT_PRIME_3, NTT_ROOT_3>(a, numA, b, numB, size, convolution3);
 
-        bool IsAtEnd() const { return (m_num <= 0); }
-        void Increment()
+        static const uint64_t prime1InverseMod2 = CalcPowerMod32(NTT_PRIME_1, NTT_PRIME_2 - 2, NTT_PRIME_2);
+        static const uint64_t prime12InverseMod3 =
+            CalcPowerMod32((uint64_t)NTT_PRIME_1 * NTT_PRIME_2 % NTT_PRIME_3, NTT_PRIME_3 - 2, NTT_PRIME_3);
+
+        uint64_t carryOver = 0;
+        for (BigInt i = 0; i < numResult; ++i)
         {
-            if (IsAtEnd())
+            UInt128 column = carryOver;
+            if (i < numResult - 1)
             {
-                return;
+                // column = r1 + p1 (t2 + p2 t3), with t2 < p2 and t3 < p3
+                const uint64_t r1 = convolution1[i];
+                const uint64_t r2 = convolution2[i];
+                const uint64_t r3 = convolution3[i];
+                const uint64_t t2 = (r2 + NTT_PRIME_2 - r1 % NTT_PRIME_2) * prime1InverseMod2 % NTT_PRIME_2;
+                const uint64_t r12 = (r1 + (uint64_t)NTT_PRIME_1 * t2) % NTT_PRIME_3;
+                const uint64_t t3 = (r3 + NTT_PRIME_3 - r12) * prime12InverseMod3 % NTT_PRIME_3;
+                column += UInt128::CalcProduct(NTT_PRIME_1, t2 + (uint64_t)NTT_PRIME_2 * t3);
+                column += r1;
             }
 
-            if (m_ptr)
-            {
-                ++m_ptr;
-            }
-            else
-            {
-                ++m_ptrptr;
-            }
-            --m_num;
+            uint64_t limb = 0;
+            carryOver = CalcDiv128(column.high, column.low, LIMB_BASE, &limb);
+            result[i] = (uint32_t)limb;
         }
+        assert(carryOver == 0);
+    }
 
-        const HugeInt& operator*() const
+    // (rows run over b, so it should be the smaller side)
+    static void MultiplyLimbsSchoolbook(const uint32_t* a, BigInt numA, const uint32_t* b, BigInt numB, uint32_t* result)
+    {
+        // each limb product is under 10^18, so a column can soak up 16 of them on top of a normalized value before carrying;
+        // a batch of rows only touches the columns from its first row up, so only those need carrying
+        std::vector<uint64_t> productLimbs(numA + numB, 0);
+        const BigInt numProductLimbs = numA + numB;
+        BigInt batchStart = 0;
+        for (BigInt i = 0; i < numB; ++i)
         {
-            if (m_ptr)
+            const uint64_t bLimb = b[i];
+            uint64_t* productRow = &productLimbs[i];
+            for (BigInt j = 0; j < numA; ++j)
             {
-                return *m_ptr;
+                productRow[j] += bLimb * a[j];
             }
-            else
+            if ((i % 16 == 15) || (i + 1 == numB))
             {
-                return **m_ptrptr;
+                uint64_t carryOver = 0;
+                for (BigInt j = batchStart; (j < numProductLimbs) && ((j < i + numA) || (carryOver > 0)); ++j)
+                {
+                    productLimbs[j] += carryOver;
+                    carryOver = productLimbs[j] / LIMB_BASE;
+                    productLimbs[j] %= LIMB_BASE;
+                }
+                assert(carryOver == 0);
+                batchStart = i + 1;
             }
         }
 
-    private:
-        const HugeInt* m_ptr;
-        const HugeInt* const* m_ptrptr;
-        BigInt m_num;
-    };
-
-    static HugeInt GetCalcedSum(ListIterator& listIter)
-    {
-        HugeInt sum;
-        sum.CalcSum(listIter);
-        return sum;
+        std::copy(productLimbs.begin(), productLimbs.end(), result);
     }
 
-    void CalcSum(ListIterator& listIter)
+    // getItem(i) returns the i'th number to add in
+    template<typename GetItem>
+    void CalcSum(BigInt numItems, GetItem getItem)
     {
-        Reset();
-
-        std::vector<ConstIterator> iterList;
-        iterList.reserve(listIter.GetNum());
-
-        // populate the list of individual iterators
-        for (; !listIter.IsAtEnd(); listIter.Increment())
+        size_t numLimbs = 0;
+        for (BigInt i = 0; i < numItems; ++i)
         {
-            iterList.push_back(ConstIterator(*listIter));
+            numLimbs = std::max(numLimbs, getItem(i).m_limbs.size());
         }
 
-        BigInt carryOver = 0;
-
-        // now iterate through the digits, starting from ones' place,
-        // adding each input number's contribution from that digit,
-        // and including any carry-over from previous digits
-
-        for (;;)
+        // add up a column of limbs at a time, starting from the lowest, carrying into the next
+        std::vector<uint32_t> sumLimbs;
+        sumLimbs.reserve(numLimbs + 1);
+        uint64_t carryOver = 0;
+        for (size_t limbIndex = 0; limbIndex < numLimbs; ++limbIndex)
         {
-            bool haveMoreDigits = false;
-            BigInt digitSum = carryOver;
-
-            for (auto iterListIter = iterList.begin(); iterListIter != iterList.end(); ++iterListIter)
+            uint64_t limbSum = carryOver;
+            for (BigInt i = 0; i < numItems; ++i)
             {
-                ConstIterator& currIter = *iterListIter;
-                digitSum += currIter.GetDigit();
-                currIter.Increment();
-                if (!currIter.IsAtEnd())
+                const std::vector<uint32_t>& itemLimbs = getItem(i).m_limbs;
+                if (limbIndex < itemLimbs.size())
                 {
-                    haveMoreDigits = true;
+                    limbSum += itemLimbs[limbIndex];
                 }
             }
+            sumLimbs.push_back((uint32_t)(limbSum % LIMB_BASE));
+            carryOver = limbSum / LIMB_BASE;
+        }
+        while (carryOver > 0)
+        {
+            sumLimbs.push_back((uint32_t)(carryOver % LIMB_BASE));
+            carryOver /= LIMB_BASE;
+        }
 
-            if ((digitSum <= 0) && !haveMoreDigits)
-            {
-                // we are done!
-                break;
-            }
+        m_limbs.swap(sumLimbs);
+        Trim();
+    }
+
+    std::vector<uint32_t> m_limbs;
+    mutable std::string m_string;   // just backs the pointer GetString hands out
+};
+
+// Hands out base^power, building on the last one handed out when the base is the same and the power has gone up,
+// so sweeping a base over increasing powers costs one single limb multiply per step instead of a whole power.
+class HugeIntPowerCache
+{
+public:
+    static const BigInt MAX_NUM_STEPS = 16;   // past this, multiply in base^(power gap) in one go
+
+    HugeIntPowerCache() : m_base(-1), m_power(-1) {}
 
-            const lldiv_t divRem = lldiv(digitSum, 10);
-            const char newDigit = (char)(divRem.rem + '0');
-            m_string += newDigit;
+    const HugeInt& GetPower(BigInt base, BigInt power)
+    {
+        assert(power >= 0);
 
-            carryOver = divRem.quot;
+        if ((base != m_base) || (power < m_power))
+        {
+            m_value.SetToPower(base, power);
+        }
+        else if (power - m_power <= MAX_NUM_STEPS)
+        {
+            for (BigInt i = m_power; i < power; ++i)
+            {
+                m_value.SetToProduct(m_value, base);
+            }
+        }
+        else
+        {
+            HugeInt gapPower;
+            gapPower.SetToPower(base, power - m_power);
+            m_value.SetToProduct(m_value, gapPower);
         }
+
+        m_base = base;
+        m_power = power;
+        return m_value;
     }
 
-    mutable std::string m_string;
-    mutable bool m_backwards;
+    void Reset() { m_base = m_power = -1; }
+
+private:
+    BigInt m_base;
+    BigInt m_power;
+    HugeInt m_value;
 };
 
 
@@ -846,6 +4323,30 @@ void TestHugeInt()
         product2.GetString(),
         product3.GetString());
 
+    HugeInt bigProduct1, bigProduct2;
+    bigProduct1.SetToProduct(n1, n2);
+    bigProduct2.SetToProduct(HugeInt("123456789012345678901234567890"), HugeInt("987654321098765432109876543210"));
+    printf(
+        "TestHugeInt big product:  n1 * n2 = %s, 123456789012345678901234567890 * 987654321098765432109876543210 = %s\n",
+        bigProduct1.GetString(),
+        bigProduct2.GetString());
+
+    // (10^n - 1)^2 = 99...9800...01, big enough to go through Karatsuba and then the NTT
+    const BigInt numNinesList[] = { 5000, 100000 };
+    for (BigInt numNines : numNinesList)
+    {
+        const HugeInt nines(std::string(numNines, '9'));
+        HugeInt ninesSquared;
+        ninesSquared.SetToProduct(nines, nines);
+        printf(
+            "TestHugeInt huge product:  (10^%lld - 1)^2 has %lld digits (expected %lld) with digit sum %lld (expected %lld)\n",
+            numNines,
+            ninesSquared.GetNumDigits(),
+            2 * numNines,
+            ninesSquared.CalcSumDigits(),
+            9 * numNines);
+    }
+
     HugeInt numer1 = 1000;
     BigInt denom1 = 200;
     HugeInt numer2 = 3;
@@ -873,6 +4374,42 @@ void TestHugeInt()
         denom3,
         quot3.GetString(),
         remainder3);
+
+    HugeInt power1, power2, power3;
+    power1.SetToPower(2, 1000);
+    power2.SetToPower(HugeInt("123456789012345678901234567890"), 3);
+    HugeIntPowerCache powerCache;
+    for (BigInt power = 0; power <= 100; power += 3)
+    {
+        power3 = powerCache.GetPower(7, power);
+    }
+    printf(
+        "TestHugeInt power:  2^1000 digit sum = %lld (expected 1366), 123456789012345678901234567890^3 = %s, 7^99 = %s\n",
+        power1.CalcSumDigits(),
+        power2.GetString(),
+        power3.GetString());
+
+    // 7^99 / 123456789012345678901234567890 and back, then 3^150000 / 7^30000 (through the Newton reciprocal) and back
+    HugeInt hugeQuot1, hugeRem1, check1, hugeQuot2, hugeRem2, check2;
+    hugeQuot1.SetToDivision(power3, HugeInt("123456789012345678901234567890"), &hugeRem1);
+    check1.SetToProduct(hugeQuot1, HugeInt("123456789012345678901234567890"));
+    check1 = check1 + hugeRem1;
+
+    HugeInt bigNumer, bigDenom;
+    bigNumer.SetToPower(3, 150000);
+    bigDenom.SetToPower(7, 30000);
+    hugeQuot2.SetToDivision(bigNumer, bigDenom, &hugeRem2);
+    check2.SetToProduct(hugeQuot2, bigDenom);
+    check2 = check2 + hugeRem2;
+    printf(
+        "TestHugeInt huge division:  7^99 / 123456789012345678901234567890 = (%s, %s), %s; 3^150000 / 7^30000 has %lld digits, %s\n",
+        hugeQuot1.GetString(),
+        hugeRem1.GetString(),
+        ((HugeInt::Compare(check1, power3) == 0) && (HugeInt::Compare(hugeRem1, HugeInt("123456789012345678901234567890")) < 0))
+            ? "checks out"
+            : "WRONG",
+        hugeQuot2.GetNumDigits(),
+        ((HugeInt::Compare(check2, bigNumer) == 0) && (HugeInt::Compare(hugeRem2, bigDenom) < 0)) ? "checks out" : "WRONG");
 }
 
 
@@ -968,36 +4505,8 @@ void RunEvenFibonacciSum(unsigned long max)
 
 BigInt CalcLargestPrimeFactor(BigInt num)
 {
-    BigInt currNum = num;
-    BigInt max = currNum / 2;
-
-    BigInt largestPrimeFactor = 0;
-
-    for (BigInt possiblePrime = 2; possiblePrime <= max; ++possiblePrime)
-    {
-        if (currNum == 1)
-        {
-            break;
-        }
-
-        for (;;)
-        {
-            const lldiv_t divRem = lldiv(currNum, possiblePrime);
-            if (divRem.quot == 0)
-            {
-                break;
-            }
-            if (divRem.rem != 0)
-            {
-                break;
-            }
-
-            largestPrimeFactor = possiblePrime;
-            currNum = divRem.quot;
-        }
-    }
-
-    return largestPrimeFactor;
+    const Factorization f = CalcFactorization(num);
+    return f.empty() ? 0 : f.back().prime;
 }
 
 void RunLargestPrimeFactor(BigInt num)
@@ -1084,22 +4593,62 @@ void RunLargestPalindromeProduct(int numDigits)
 ////////////////////////////
 // Problem 5 - Smallest multiple
 
-BigInt CalcSmallestMultiple(BigInt max)
+// LCM(1..max) is the product of the largest power <= max of each prime <= max.
+// The prime powers are packed into word-sized leaves, which are then multiplied together pairwise,
+// level by level, so the big multiplications are always between numbers of about the same size.
+void CalcSmallestMultiple(BigInt max, HugeInt& multiple)
 {
-    s_factorizationCache.PopulateCache(max);
+    std::vector<HugeInt> productList;
+    BigInt leaf = 1;
+    for (BigInt prime : Primes(2, max + 1))
+    {
+        BigInt primePower = prime;
+        while (primePower <= max / prime)
+        {
+            primePower *= prime;
+        }
 
-    Factorization f;
-    for (BigInt i = 1; i <= max; ++i)
+        if (leaf > MAX_BIG_INT / primePower)
+        {
+            productList.push_back(HugeInt(leaf));
+            leaf = 1;
+        }
+        leaf *= primePower;
+    }
+    productList.push_back(HugeInt(leaf));
+
+    while (productList.size() > 1)
     {
-        f.Absorb(s_factorizationCache.Factorize(i));
+        const size_t numProducts = productList.size();
+        for (size_t i = 0; i + 1 < numProducts; i += 2)
+        {
+            productList[i / 2].SetToProduct(productList[i], productList[i + 1]);
+        }
+        if (numProducts & 1)
+        {
+            productList[numProducts / 2].Swap(productList[numProducts - 1]);
+        }
+        productList.resize((numProducts + 1) / 2);
     }
 
-    return f.CalcProduct();
+    multiple.Swap(productList[0]);
 }
 
 void RunSmallestMultiple(BigInt max)
 {
-    printf("Smallest multiple of all numbers from 1 to %lld = %lld\n", max, CalcSmallestMultiple(max));
+    HugeInt multiple;
+    CalcSmallestMultiple(max, multiple);
+
+    if (multiple.GetNumDigits() <= 50)
+    {
+        printf("Smallest multiple of all numbers from 1 to %lld = %s\n", max, multiple.GetString());
+    }
+    else
+    {
+        printf("Smallest multiple of all numbers from 1 to %lld = ", max);
+        multiple.PrintDigits(20);
+        printf("... (%lld digits)\n", multiple.GetNumDigits());
+    }
 }
 
 
@@ -1132,6 +4681,12 @@ void SumSquareDifference(BigInt max)
 
 BigInt CalcNthPrime(BigInt n)
 {
+    if (n >= (1LL << 20))
+    {
+        // count up to an estimate instead of sieving everything below the answer
+        return CalcNthPrimeByCounting(n);
+    }
+
     return s_primeFinder.FindNthPrime(n);
 }
 
@@ -1265,16 +4820,22 @@ void RunSpecialPythagoreanTriplet()
 ////////////////////////////
 // Problem 10 - Summation of primes
 
-BigInt CalcSumOfPrimesBelow(BigInt max)
+// (128 bits, since the sum passes 2^63 somewhere under 3 * 10^10)
+UInt128 CalcSumOfPrimesBelow(BigInt max)
 {
-    s_primeFinder.FindPrimesBelow(max);
-    //s_primeFinder.PrintPrimes();
-    return std::accumulate(s_primeFinder.begin(), s_primeFinder.end(), 0LL);
+    if (max >= (1LL << 24))
+    {
+        // sublinear prime sum, rather than sieving every prime
+        return CalcPrimeSum(max - 1);
+    }
+
+    // reduce straight out of the (parallel) sieve, rather than building up the prime list first
+    return SumPrimesInRange(2, max);
 }
 
 void RunSummationOfPrimes(BigInt max)
 {
-    printf("Sum of primes under %lld = %lld\n", max, CalcSumOfPrimesBelow(max));
+    printf("Sum of primes under %lld = %s\n", max, CalcSumOfPrimesBelow(max).GetString().c_str());
 }
 
 
@@ -1481,6 +5042,88 @@ void RunLargestGridProduct(BigInt sequenceLength)
 ////////////////////////////
 // Problem 12 - Highly divisible triangle number
 
+// Divisor counts d(k) for a sliding block of consecutive k, by segmented factor sieving:  every base prime p
+// divides its exponent out of each multiple of p in the block at once, and anything left over is one last big prime.
+// Holds just the one block plus the base primes up to sqrt of its top, however far up it has slid.
+class DivisorCountWindow
+{
+public:
+    static const BigInt BLOCK_SIZE = 64 * 1024;
+
+    DivisorCountWindow() : m_lo(0), m_hi(0), m_basePrimeLimit(0) {}
+
+    BigInt GetDivisorCount(BigInt num)
+    {
+        assert(num >= 1);
+        if ((num < m_lo) || (num >= m_hi))
+        {
+            SieveBlock(num);
+        }
+        return m_divisorCountList[num - m_lo];
+    }
+
+
+private:
+    void SieveBlock(BigInt lo)
+    {
+        m_lo = lo;
+        m_hi = lo + BLOCK_SIZE;
+        if (m_basePrimeLimit * m_basePrimeLimit < m_hi)
+        {
+            // sieve the base primes well past what's needed, so they're only redone every so often
+            m_basePrimeLimit = 2 * CalcSqrtFloor(m_hi) + 1;
+            FindBasePrimes(m_basePrimeLimit, m_basePrimes);
+        }
+
+        m_divisorCountList.assign(BLOCK_SIZE, 1);
+        m_remainingList.resize(BLOCK_SIZE);
+        for (BigInt i = 0; i < BLOCK_SIZE; ++i)
+        {
+            m_remainingList[i] = m_lo + i;
+        }
+
+        for (auto iter = m_basePrimes.begin(); (iter != m_basePrimes.end()) && (*iter * *iter < m_hi); ++iter)
+        {
+            const BigInt prime = *iter;
+            for (BigInt num = ((m_lo + prime - 1) / prime) * prime; num < m_hi; num += prime)
+            {
+                BigInt& remaining = m_remainingList[num - m_lo];
+                BigInt numFactors = 0;
+                do
+                {
+                    remaining /= prime;
+                    ++numFactors;
+                } while (remaining % prime == 0);
+                m_divisorCountList[num - m_lo] *= (uint32_t)(numFactors + 1);
+            }
+        }
+
+        for (BigInt i = 0; i < BLOCK_SIZE; ++i)
+        {
+            if (m_remainingList[i] > 1)
+            {
+                m_divisorCountList[i] *= 2;
+            }
+        }
+    }
+
+    BigInt m_lo;
+    BigInt m_hi;
+    BigInt m_basePrimeLimit;
+    std::vector<BigInt> m_basePrimes;
+    std::vector<uint32_t> m_divisorCountList;
+    std::vector<BigInt> m_remainingList;
+};
+
+// d(k / 2) for even k, from d(k):  with k = 2^e * m, d(k) = (e + 1) * d(m) and d(k / 2) = e * d(m)
+BigInt CalcHalfDivisorCount(BigInt num, BigInt divisorCount)
+{
+    const BigInt numTwos = CalcLowestSetBit((uint64_t)num);
+    return divisorCount / (numTwos + 1) * numTwos;
+}
+
+// T(n) = n (n + 1) / 2, and n and n + 1 are coprime, so T(n) splits into coprime halves (n / 2 and n + 1, or n and (n + 1) / 2),
+// and d(T(n)) = d(one half) * d(the other).  Each step only needs the divisor count of the next n + 1 out of the window.
 BigInt CalcFirstHighlyDivTriNumber(BigInt moreThanNumDivisors, bool verbose)
 {
     BigInt triangleNumber = 1;
@@ -1490,21 +5133,26 @@ BigInt CalcFirstHighlyDivTriNumber(BigInt moreThanNumDivisors, bool verbose)
         printf("Triangle number #1 = %lld\n", triangleNumber);
     }
 
+    DivisorCountWindow window;
+    BigInt numDivisorsN = window.GetDivisorCount(nextNaturalNumber);
     for (;;)
     {
-        triangleNumber = triangleNumber + nextNaturalNumber;
+        const BigInt n = nextNaturalNumber;
+        triangleNumber = triangleNumber + n;
         if (verbose)
         {
-            printf("Triangle number #%lld = %lld", nextNaturalNumber, triangleNumber);
+            printf("Triangle number #%lld = %lld", n, triangleNumber);
         }
         nextNaturalNumber++;
 
-        const Factorization& f = s_factorizationCache.Factorize(triangleNumber);
-        BigInt numDivisors = f.CalcNumDivisors();
+        const BigInt numDivisorsNextN = window.GetDivisorCount(n + 1);
+        const BigInt numDivisors = (n & 1) ? numDivisorsN * CalcHalfDivisorCount(n + 1, numDivisorsNextN)
+                                           : CalcHalfDivisorCount(n, numDivisorsN) * numDivisorsNextN;
+        numDivisorsN = numDivisorsNextN;
         if (numDivisors > moreThanNumDivisors)
         {
             printf("\nFound more than %lld divisors (%lld).  Prime factors:  ", moreThanNumDivisors, numDivisors);
-            f.PrintFactors();
+            CalcFactorization(triangleNumber).PrintFactors();
             printf("\n");
             break;
         }
@@ -2124,29 +5772,23 @@ void RunFactorialDigitSum(BigInt num)
 
 BigInt CalcSumProperDivisors(BigInt num, bool verbose = false)
 {
-    if (verbose)
+    if (!verbose)
     {
-        printf("Proper divisors of %lld:  1 ", num);
+        return (num > 1) ? CalcSumDivisors(num) - num : 0;
     }
 
-    BigInt sum = 1;
+    printf("Proper divisors of %lld:  ", num);
 
-    const BigInt maxDiv = num / 2;
-    for (BigInt i = 2; i <= maxDiv; ++i)
-    {
-        if (num % i == 0)
-        {
-            if (verbose)
-            {
-                printf("%lld ", i);
-            }
-            sum += i;
-        }
-    }
-    if (verbose)
+    std::vector<BigInt> divisorList;
+    CalcFactorization(num).CalcDivisors(divisorList, true, num / 2);
+
+    BigInt sum = 0;
+    for (auto iter = divisorList.begin(); iter != divisorList.end(); ++iter)
     {
-        printf("\n");
+        printf("%lld ", *iter);
+        sum += *iter;
     }
+    printf("\n");
 
     return sum;
 }
@@ -2156,6 +5798,9 @@ BigInt CalcSumAmicableNumbers(BigInt max)
     std::vector<bool> amicableFlags;
     amicableFlags.resize(max, false);
 
+    std::vector<BigInt> sumProperDivisorsList;
+    CalcSumProperDivisorsTable(max, sumProperDivisorsList);
+
     BigInt sum = 0;
     for (BigInt i = 1; i < max; ++i)
     {
@@ -2164,13 +5809,23 @@ BigInt CalcSumAmicableNumbers(BigInt max)
             continue;
         }
 
-        const BigInt other = CalcSumProperDivisors(i);
+        const BigInt other = sumProperDivisorsList[i];
         if (other == i)
         {
             continue;
         }
 
-        const BigInt sumProperDivOther = CalcSumProperDivisors(other);
+        if (other >= max)
+        {
+            // the partner is past the table (and past max, so only this one counts), so factor it directly
+            if (CalcSumProperDivisors(other) == i)
+            {
+                sum += i;
+            }
+            continue;
+        }
+
+        const BigInt sumProperDivOther = sumProperDivisorsList[other];
         if (sumProperDivOther == i)
         {
             assert(
@@ -2201,6 +5856,28 @@ void TestSumAllAmicableNumbers(BigInt max)
     printf("The sum of all amicable numbers under %lld = %lld\n", max, CalcSumAmicableNumbers(max));
 }
 
+// checks the table based sum against factoring each number (and its partner) one at a time
+void TestAmicableNumbersBruteForce(BigInt max)
+{
+    BigInt bruteForceSum = 0;
+    for (BigInt i = 2; i < max; ++i)
+    {
+        const BigInt other = CalcSumProperDivisors(i);
+        if ((other != i) && (CalcSumProperDivisors(other) == i))
+        {
+            bruteForceSum += i;
+        }
+    }
+
+    const BigInt sum = CalcSumAmicableNumbers(max);
+    printf(
+        "TestAmicableNumbersBruteForce:  sum under %lld = %lld, brute force = %lld, %s\n",
+        max,
+        sum,
+        bruteForceSum,
+        (sum == bruteForceSum) ? "match" : "MISMATCH");
+}
+
 void RunAmicableNumbers()
 {
     TestCalcSumProperDivisors(220);
@@ -2210,6 +5887,8 @@ void RunAmicableNumbers()
     TestSumAllAmicableNumbers(100);
     TestSumAllAmicableNumbers(1000);
     TestSumAllAmicableNumbers(10000);
+    TestAmicableNumbersBruteForce(1000000);   // has the pairs 947835/1125765 and 998104/1043096 straddling max
+    TestSumAllAmicableNumbers(10000000);
 }
 
 
@@ -2297,14 +5976,13 @@ void RunNamesScores()
 ////////////////////////////
 // Problem 23 - Non-abundant sums
 
-bool IsAbundant(BigInt num)
+bool IsAbundant(BigInt num, BigInt sumProperDivisors)
 {
     if (num <= 0)
     {
         return false;
     }
 
-    const BigInt sumProperDivisors = CalcSumProperDivisors(num, false);
     const bool isAbundant = (sumProperDivisors > num);
 
     /*
@@ -2328,9 +6006,12 @@ void DetermineAbundantness(std::vector<bool>& flagList, BigInt numNums)
     flagList.resize(0);
     flagList.reserve(numNums);
 
+    std::vector<BigInt> sumProperDivisorsList;
+    CalcSumProperDivisorsTable(numNums, sumProperDivisorsList);
+
     for (BigInt num = 0; num < numNums; ++num)
     {
-        flagList.push_back(IsAbundant(num));
+        flagList.push_back(IsAbundant(num, sumProperDivisorsList[num]));
     }
 }
 
@@ -2506,56 +6187,139 @@ BigInt CalcNumFactors(BigInt numer, BigInt denom, BigInt* remainder = nullptr)
     return numFactors;
 }
 
-BigInt CalcReciprocalCycleLength(BigInt denom)
+// The 2s and 5s of the denominator only delay the start of the cycle, so the cycle of 1 / d is that of 1 / m,
+// with m what's left of d without them.  Its length is the smallest k with m | 10^k - 1 (that many nines),
+// which is the multiplicative order of 10 mod m.
+BigInt CalcReciprocalCycleLength(BigInt denom, bool verbose = false)
 {
-    printf("denom = %lld:  ", denom);
+    if (verbose)
+    {
+        printf("denom = %lld:  ", denom);
+    }
 
     const BigInt numFactors2 = CalcNumFactors(denom, 2, &denom);
     const BigInt numFactors5 = CalcNumFactors(denom, 5, &denom);
-    printf("nf2(%lld), nf5(%lld), ", numFactors2, numFactors5);
+    if (verbose)
+    {
+        printf("nf2(%lld), nf5(%lld), ", numFactors2, numFactors5);
+
+        const BigInt numTens = std::max(numFactors2, numFactors5);
 
-    const BigInt numTens = std::max(numFactors2, numFactors5);
+        const BigInt tens = (BigInt)pow(10.0, numTens);
+        printf("tens = %lld (10^%lld)", tens, numTens);
+    }
 
-    const BigInt tens = (BigInt)pow(10.0, numTens);
-    printf("tens = %lld (10^%lld)", tens, numTens);
+    const BigInt cycleLength = (denom > 1) ? CalcMultiplicativeOrder(10, denom) : 0;
 
-    HugeInt nines;
-    if (denom > 1)
+    if (verbose)
     {
-        for (;;)
-        {
-            nines.AppendDigit(9);
+        printf(", num nines = %lld\n", cycleLength);
+    }
+
+    return cycleLength;
+}
+
+// Longest cycle of 1 / d for 2 <= d < maxDenom (the smallest such d, on ties).
+// Worker threads claim chunks of denominators from the top down, and since the cycle of 1 / d is at most d - 1,
+// any d with d - 1 short of the longest cycle found so far is skipped (and once a whole chunk is, so is everything below it).
+BigInt FindLongestReciprocalCycle(BigInt maxDenom, BigInt* longestCycleLength, BigInt numThreads = 0)
+{
+    static const BigInt s_chunkSize = 4096;
+
+    // fill in the SPF table up front, since it can't grow while the workers are running
+    s_factorizationCache.PopulateCache(maxDenom);
 
-            HugeInt div;
-            BigInt remainder;
-            div.SetToDivision(nines, denom, &remainder);
+    std::atomic<BigInt> nextChunkIndex(0);
+    std::atomic<BigInt> sharedLongestLength(0);
 
-            if (remainder == 0)
+    numThreads = CalcNumSieveThreads(numThreads);
+    std::vector<BigInt> threadLengthList(numThreads, 0);
+    std::vector<BigInt> threadDenomList(numThreads, 0);
+
+    auto worker = [&](BigInt threadIndex) {
+        BigInt& longestLength = threadLengthList[threadIndex];
+        BigInt& longestDenom = threadDenomList[threadIndex];
+        for (;;)
+        {
+            const BigInt chunkHi = maxDenom - s_chunkSize * nextChunkIndex++;
+            const BigInt chunkLo = std::max(chunkHi - s_chunkSize, 2LL);
+            if ((chunkHi <= chunkLo) || (chunkHi - 2 < sharedLongestLength))
             {
                 break;
             }
+
+            for (BigInt denom = chunkHi - 1; denom >= chunkLo; --denom)
+            {
+                if (denom - 1 < sharedLongestLength)
+                {
+                    break;
+                }
+
+                const BigInt cycleLength = CalcReciprocalCycleLength(denom);
+                if ((cycleLength > longestLength) || ((cycleLength == longestLength) && (denom < longestDenom)))
+                {
+                    longestLength = cycleLength;
+                    longestDenom = denom;
+
+                    BigInt sharedLength = sharedLongestLength;
+                    while ((cycleLength > sharedLength) && !sharedLongestLength.compare_exchange_weak(sharedLength, cycleLength))
+                    {
+                    }
+                }
+            }
         }
+    };
+
+    std::vector<std::thread> threadList;
+    for (BigInt t = 1; t < numThreads; ++t)
+    {
+        threadList.emplace_back(worker, t);
+    }
+    worker(0);
+    for (auto iter = threadList.begin(); iter != threadList.end(); ++iter)
+    {
+        iter->join();
     }
 
-    printf(", num nines = %lld\n", nines.GetNumDigits());
+    BigInt longestLength = 0;
+    BigInt longestDenom = 0;
+    for (BigInt t = 0; t < numThreads; ++t)
+    {
+        if ((threadLengthList[t] > longestLength) || ((threadLengthList[t] == longestLength) && (threadDenomList[t] < longestDenom)))
+        {
+            longestLength = threadLengthList[t];
+            longestDenom = threadDenomList[t];
+        }
+    }
 
-    return nines.GetNumDigits();
+    if (longestCycleLength != nullptr)
+    {
+        *longestCycleLength = longestLength;
+    }
+    return longestDenom;
 }
 
-void RunReciprocalCycles(BigInt maxDenom)
+void RunReciprocalCycles(BigInt maxDenom, bool verbose)
 {
     BigInt longestCycleLength = 0;
     BigInt longestCycleDenom = 0;
 
-    for (BigInt denom = 2; denom < maxDenom; ++denom)
+    if (verbose)
     {
-        const BigInt cycLen = CalcReciprocalCycleLength(denom);
-        if (cycLen > longestCycleLength)
+        for (BigInt denom = 2; denom < maxDenom; ++denom)
         {
-            longestCycleLength = cycLen;
-            longestCycleDenom = denom;
+            const BigInt cycLen = CalcReciprocalCycleLength(denom, true);
+            if (cycLen > longestCycleLength)
+            {
+                longestCycleLength = cycLen;
+                longestCycleDenom = denom;
+            }
         }
     }
+    else
+    {
+        longestCycleDenom = FindLongestReciprocalCycle(maxDenom, &longestCycleLength);
+    }
 
     printf(
         "The longest decimal cycle for 1 / d where d < %lld is:  d = %lld, cycleLength = %lld\n",
@@ -2711,39 +6475,46 @@ void RunNumberSpiralDiagonals(BigInt size)
 ////////////////////////////
 // Problem 29 - Distinct powers
 
-BigInt CalcNumDistinctPowerTerms(BigInt min, BigInt max)
+BigInt CalcNumDistinctPowerTerms(BigInt min, BigInt max, bool verbose)
 {
     std::set<HugeInt, HugeInt::Sorter> set;
 
-    HugeInt power;
+    // b sweeps upward for each a, so each power is just the last one times a
+    HugeIntPowerCache powerCache;
 
     for (BigInt a = min; a <= max; ++a)
     {
         for (BigInt b = min; b <= max; ++b)
         {
-            power.SetToPower(a, b);
-            printf("%lld ^ %lld = %s\n", a, b, power.GetString());
+            const HugeInt& power = powerCache.GetPower(a, b);
+            if (verbose)
+            {
+                printf("%lld ^ %lld = %s\n", a, b, power.GetString());
+            }
             set.insert(power);
         }
     }
 
-    printf("Distinct terms:  ");
-    for (auto iter = set.begin(); iter != set.end(); ++iter)
+    if (verbose)
     {
-        printf("%s ", iter->GetString());
+        printf("Distinct terms:  ");
+        for (auto iter = set.begin(); iter != set.end(); ++iter)
+        {
+            printf("%s ", iter->GetString());
+        }
+        printf("\n");
     }
-    printf("\n");
 
     return (BigInt)set.size();
 }
 
-void RunDistinctPowers(BigInt min, BigInt max)
+void RunDistinctPowers(BigInt min, BigInt max, bool verbose = false)
 {
     printf(
         "The number of distinct power terms with a and b varying from %lld to %lld = %lld\n",
         min,
         max,
-        CalcNumDistinctPowerTerms(min, max));
+        CalcNumDistinctPowerTerms(min, max, verbose));
 }
 
 
@@ -3102,9 +6873,9 @@ BigInt CalcNumCircularPrimes(BigInt max)
     BigInt count = 0;
 
     s_primeCache.IsPrime(max - 1);
-    for (BigInt i = 2; i < max; ++i)
+    for (BigInt prime : Primes(2, max))
     {
-        if (IsCircularPrime(i))
+        if (IsCircularPrime(prime))
         {
             ++count;
         }
@@ -3531,6 +7302,8 @@ void RunChampernownesConstant(BigInt numPowersOf10, bool printAllDigits)
 
 void RunPandigitalPrime()
 {
+    static const BigInt BATCH_SIZE = 64;
+
     std::string digitString = "987654321";
     const BigInt digitStringLength = digitString.length();
 
@@ -3539,23 +7312,39 @@ void RunPandigitalPrime()
         char* begin = &digitString[i];
         char* end = begin + digitStringLength - i;
 
+        // permutations come out in descending order, so gather them up and test them a batch at a time,
+        // taking the first prime of the first batch that has one
         BigInt foundPrime = -1;
-        RecurseLexicoPermut(begin, begin, end, [&](const char* st) {
-            //printf("Testing %s... ", st);
-            const BigInt num = atoi(st);
-
-            if (IsNumberPrime(num))
+        std::vector<BigInt> batch;
+        bool isPrimeList[BATCH_SIZE];
+        auto testBatch = [&]() {
+            AreNumbersPrime(batch.data(), (BigInt)batch.size(), isPrimeList);
+            for (BigInt j = 0; j < (BigInt)batch.size(); ++j)
             {
-                foundPrime = num;
-                //printf("is PRIME!\n");
-                return false;
+                if (isPrimeList[j])
+                {
+                    foundPrime = batch[j];
+                    break;
+                }
             }
-            else
+            batch.clear();
+        };
+
+        RecurseLexicoPermut(begin, begin, end, [&](const char* st) {
+            //printf("Testing %s... ", st);
+            batch.push_back(atoi(st));
+            if ((BigInt)batch.size() >= BATCH_SIZE)
             {
-                //printf("is not prime\n");
-                return true;
+                testBatch();
             }
+
+            // keep going until a batch turns up a prime
+            return (foundPrime < 0);
         });
+        if (foundPrime < 0)
+        {
+            testBatch();
+        }
 
         if (foundPrime > 0)
         {
@@ -3741,7 +7530,9 @@ int main(int argc, char** argv)
             "Usages:\n"
             "  ProjectEuler <problem#>\n"
             "  ProjectEuler factorization\n"
-            "  ProjectEuler primeFinder\n");
+            "  ProjectEuler primeFinder\n"
+            "  ProjectEuler primeCount [x]\n"
+            "  ProjectEuler primeBitmap <file> <limit>\n");
         return 0;
     }
 
@@ -3750,17 +7541,45 @@ int main(int argc, char** argv)
     {
         if (argc >= 3)
         {
-            PrintFactorization(atoi(argv[2]));
+            PrintFactorization(atoll(argv[2]));
         }
         else
         {
             TestFactorizationRange(20);
+            TestMultiplicativeTables(100000);
+            TestSumProperDivisorsTable(100000);
+            TestDivisorEnumeration(10000);
+            TestFactorizationCacheThreads(1000000000000LL, 20000, 4);
+            TestFactorizationCacheBudget(4 * 1024 * 1024);
+            TestFactorizeRangeWindow(1000000000000LL, 1000000);
         }
         return 0;
     }
     else if (strcmp(problemArg, "primeFinder") == 0)
     {
         TestPrimeFinder(10);
+        TestPrimeFinderSieveMode(SIEVE_MODE_SEGMENTED, 1000000);
+        TestPrimeFinderSieveMode(SIEVE_MODE_WHEEL, 1000000);
+        TestPrimeCache(1000000);
+        TestPrimeRange(0, 1000000);
+        TestPrimeRange(999000, 3000017);
+        return 0;
+    }
+    else if (strcmp(problemArg, "primeCount") == 0)
+    {
+        if (argc >= 3)
+        {
+            TestPrimeCounting(atoll(argv[2]));
+        }
+        else
+        {
+            TestPrimeCountingSwitchOvers();
+        }
+        return 0;
+    }
+    else if ((strcmp(problemArg, "primeBitmap") == 0) && (argc >= 3))
+    {
+        RunPrimeBitmapFile(argv[2], (argc >= 4) ? atoll(argv[3]) : 100000000LL);
         return 0;
     }
     else if (strcmp(problemArg, "HugeInt") == 0)
@@ -3795,6 +7614,7 @@ int main(int argc, char** argv)
             RunSmallestMultiple(10);
             RunSmallestMultiple(20);
             RunSmallestMultiple(30);
+            RunSmallestMultiple(100000);
             break;
         case 6:
             SumSquareDifference(10);
@@ -3818,6 +7638,7 @@ int main(int argc, char** argv)
             RunSummationOfPrimes(10);
             RunSummationOfPrimes(100);
             RunSummationOfPrimes(2000000);
+            RunSummationOfPrimes(100000000000LL);   // (past 2^63)
             RunSummationOfPrimes(100);
             RunSummationOfPrimes(10);
             break;
@@ -3831,6 +7652,8 @@ int main(int argc, char** argv)
             RunHighlyDivisibleTriangleNumber(5, true);
             RunHighlyDivisibleTriangleNumber(100, false);
             RunHighlyDivisibleTriangleNumber(500, true);
+            RunHighlyDivisibleTriangleNumber(5000, false);
+            RunHighlyDivisibleTriangleNumber(10000, false);
             break;
         case 13:
             RunFirstDigitsOfLargeSum(10);
@@ -3896,10 +7719,12 @@ int main(int argc, char** argv)
             RunNDigitFibonacci(1000);
             break;
         case 26:
-            //RunReciprocalCycles(10);
-            //RunReciprocalCycles(20);
-            //RunReciprocalCycles(100);
-            RunReciprocalCycles(1000);
+            //RunReciprocalCycles(10, true);
+            //RunReciprocalCycles(20, true);
+            //RunReciprocalCycles(100, true);
+            RunReciprocalCycles(1000, true);
+            RunReciprocalCycles(1000, false);
+            RunReciprocalCycles(10000000, false);
             break;
         case 27:
             RunQuadraticPrimes();
@@ -3912,7 +7737,8 @@ int main(int argc, char** argv)
         case 29:
             //RunDistinctPowers(2, 5);
             //RunDistinctPowers(2, 20);
-            RunDistinctPowers(2, 100);
+            RunDistinctPowers(2, 100, true);
+            RunDistinctPowers(2, 1000);
             break;
         case 30:
             RunDigitPowers(3);